@@ -0,0 +1,375 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <sys/mman.h>
+
+//allocators whose blocks can be resized: on top of allocate/deallocate they
+//provide T* reallocate(T* p, size_t old_n, size_t new_n) with the semantics of
+//realloc, i.e. the first min(old_n, new_n) elements are moved bytewise.
+//hot_set detects it (allocator_can_reallocate) and grows in place with it
+
+//malloc/realloc/free. glibc serves large blocks with mmap and resizes them with
+//mremap, which remaps the pages instead of copying them: growing a large block
+//never needs the old and the new block at the same time
+template<class T>
+struct realloc_allocator
+{
+	typedef T value_type;
+
+	template<class U>
+	struct rebind
+	{
+		typedef realloc_allocator<U> other;
+	};
+
+	realloc_allocator() = default;
+
+	template<class U>
+	realloc_allocator(const realloc_allocator<U>&)
+	{}
+
+	T* allocate(size_t n_)
+	{
+		if (n_ == 0)
+			return nullptr;
+		auto p = std::malloc(n_ * sizeof(T));
+		if (!p)
+			throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p_, size_t)
+	{
+		std::free(p_);
+	}
+
+	//on failure p_ is left untouched
+	T* reallocate(T* p_, size_t, size_t new_n_)
+	{
+		auto p = std::realloc(p_, new_n_ * sizeof(T));
+		if (!p)
+			throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+
+	//stx::btree destroys its nodes through the allocator
+	template<class U>
+	void destroy(U* p_)
+	{
+		p_->~U();
+	}
+
+	template<class U>
+	bool operator==(const realloc_allocator<U>&) const
+	{
+		return true;
+	}
+
+	template<class U>
+	bool operator!=(const realloc_allocator<U>&) const
+	{
+		return false;
+	}
+};
+
+namespace detail
+{
+
+static const size_t huge_page_size = size_t(2) << 20;
+
+//blocks of at least this size get their own mapping
+static const size_t huge_page_threshold = huge_page_size / 2;
+
+inline void advise_huge_pages(void* p_, size_t bytes_)
+{
+#ifdef MADV_HUGEPAGE
+	madvise(p_, bytes_, MADV_HUGEPAGE);
+#else
+	(void)p_;
+	(void)bytes_;
+#endif
+}
+
+inline size_t round_to_huge_pages(size_t bytes_)
+{
+	return (bytes_ + huge_page_size - 1) & ~(huge_page_size - 1);
+}
+
+//bytes_ must be a multiple of huge_page_size. an anonymous mapping starting
+//on a 2MB boundary, not yet advised
+inline void* map_aligned(size_t bytes_)
+{
+	auto raw = mmap(nullptr, bytes_ + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
+		throw std::bad_alloc();
+
+	//the kernel only backs huge page aligned ranges with huge pages
+	auto first = uintptr_t(raw);
+	auto aligned = (first + huge_page_size - 1) & ~(huge_page_size - 1);
+	if (aligned != first)
+		munmap(raw, aligned - first);
+	auto tail = first + bytes_ + huge_page_size - (aligned + bytes_);
+	if (tail != 0)
+		munmap(reinterpret_cast<void*>(aligned + bytes_), tail);
+	return reinterpret_cast<void*>(aligned);
+}
+
+//bytes_ must be a multiple of huge_page_size. explicit huge pages if the
+//system has some reserved (vm.nr_hugepages), otherwise a 2MB aligned mapping
+//advised for transparent huge pages; without THP that is plain 4KB pages
+inline void* map_huge_pages(size_t bytes_)
+{
+#ifdef MAP_HUGETLB
+	auto explicit_pages = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (explicit_pages != MAP_FAILED)
+		return explicit_pages;
+#endif
+	auto p = map_aligned(bytes_);
+	advise_huge_pages(p, bytes_);
+	return p;
+}
+
+//small blocks (btree nodes, ht_chained buckets) carved out of huge page
+//mappings, so that they share TLB entries too. freed blocks go to a free list
+//per 64-byte size class and are never returned to the system
+class huge_page_pool
+{
+public:
+	enum : size_t { granularity = 64, max_block = 4096, num_classes = max_block / granularity };
+
+	static huge_page_pool& instance()
+	{
+		static huge_page_pool pool;
+		return pool;
+	}
+
+	void* allocate(size_t bytes_)
+	{
+		auto c = size_class(bytes_);
+		auto block = (c + 1) * granularity;
+		std::lock_guard<std::mutex> lock(mmutex);
+		if (auto p = mfree[c])
+		{
+			mfree[c] = *static_cast<void**>(p);
+			return p;
+		}
+		if (size_t(mlimit - mcursor) < block)
+		{
+			mcursor = static_cast<char*>(map_huge_pages(huge_page_size));
+			mlimit = mcursor + huge_page_size;
+		}
+		auto p = mcursor;
+		mcursor += block;
+		return p;
+	}
+
+	void deallocate(void* p_, size_t bytes_)
+	{
+		auto c = size_class(bytes_);
+		std::lock_guard<std::mutex> lock(mmutex);
+		*static_cast<void**>(p_) = mfree[c];
+		mfree[c] = p_;
+	}
+
+private:
+	static size_t size_class(size_t bytes_)
+	{
+		return (bytes_ - 1) / granularity;
+	}
+
+	std::mutex mmutex;
+	void* mfree[num_classes] = {};
+	char* mcursor = nullptr;
+	char* mlimit = nullptr;
+};
+
+inline void* huge_allocate(size_t bytes_)
+{
+	if (bytes_ == 0)
+		return nullptr;
+	if (bytes_ <= huge_page_pool::max_block)
+		return huge_page_pool::instance().allocate(bytes_);
+	if (bytes_ < huge_page_threshold)
+	{
+		auto p = std::malloc(bytes_);
+		if (!p)
+			throw std::bad_alloc();
+		return p;
+	}
+	return map_huge_pages(round_to_huge_pages(bytes_));
+}
+
+inline void huge_deallocate(void* p_, size_t bytes_)
+{
+	if (p_ == nullptr)
+		return;
+	if (bytes_ <= huge_page_pool::max_block)
+		huge_page_pool::instance().deallocate(p_, bytes_);
+	else if (bytes_ < huge_page_threshold)
+		std::free(p_);
+	else
+		munmap(p_, round_to_huge_pages(bytes_));
+}
+
+inline void* huge_reallocate(void* p_, size_t old_bytes_, size_t new_bytes_)
+{
+	if (old_bytes_ >= huge_page_threshold && new_bytes_ >= huge_page_threshold)
+	{
+		//remaps the pages instead of copying them. fails for MAP_HUGETLB
+		//mappings on kernels older than 5.16, which then take the copy below
+		auto old_size = round_to_huge_pages(old_bytes_);
+		auto new_size = round_to_huge_pages(new_bytes_);
+
+		//in place if the range after the block is free, which keeps the address
+		auto p = mremap(p_, old_size, new_size, 0);
+#ifdef MREMAP_FIXED
+		//otherwise into a range reserved on a 2MB boundary: wherever the kernel
+		//would move it, the block could straddle huge pages and be split into 4KB ones
+		if (p == MAP_FAILED)
+		{
+			auto target = map_aligned(new_size);
+			p = mremap(p_, old_size, new_size, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+			if (p == MAP_FAILED)
+				munmap(target, new_size);
+		}
+#endif
+		if (p != MAP_FAILED)
+		{
+			advise_huge_pages(p, new_size);
+			return p;
+		}
+	}
+	auto p = huge_allocate(new_bytes_);
+	if (p_ != nullptr)
+		std::memcpy(p, p_, old_bytes_ < new_bytes_ ? old_bytes_ : new_bytes_);
+	huge_deallocate(p_, old_bytes_);
+	return p;
+}
+
+}
+
+//allocator for large tables: blocks from huge_page_threshold (1MB) up get their
+//own mapping backed by 2MB pages (see detail::map_huge_pages), so a random
+//probe into a multi-GB slot array costs one TLB entry per 2MB instead of
+//per 4KB. blocks up to 4KB come from a shared pool of huge pages, the rest from
+//malloc. usable as hot_set's Alloc, ht_chained's Alloc and btree's _Alloc.
+//alignof(T) must not exceed alignof(std::max_align_t)
+template<class T>
+struct huge_page_allocator
+{
+	typedef T value_type;
+
+	template<class U>
+	struct rebind
+	{
+		typedef huge_page_allocator<U> other;
+	};
+
+	huge_page_allocator() = default;
+
+	template<class U>
+	huge_page_allocator(const huge_page_allocator<U>&)
+	{}
+
+	T* allocate(size_t n_)
+	{
+		return static_cast<T*>(detail::huge_allocate(n_ * sizeof(T)));
+	}
+
+	void deallocate(T* p_, size_t n_)
+	{
+		detail::huge_deallocate(p_, n_ * sizeof(T));
+	}
+
+	//mremap for large blocks, so hot_set grows in place with this allocator too
+	T* reallocate(T* p_, size_t old_n_, size_t new_n_)
+	{
+		return static_cast<T*>(detail::huge_reallocate(p_, old_n_ * sizeof(T), new_n_ * sizeof(T)));
+	}
+
+	//stx::btree destroys its nodes through the allocator
+	template<class U>
+	void destroy(U* p_)
+	{
+		p_->~U();
+	}
+
+	template<class U>
+	bool operator==(const huge_page_allocator<U>&) const
+	{
+		return true;
+	}
+
+	template<class U>
+	bool operator!=(const huge_page_allocator<U>&) const
+	{
+		return false;
+	}
+};
+
+//blocks aligned to a cache line, for arrays laid out so that a node's
+//descendants share lines (eytzinger_set). plain aligned new/delete
+template<class T>
+struct cache_aligned_allocator
+{
+	typedef T value_type;
+
+	enum : size_t { alignment = 64 };
+
+	template<class U>
+	struct rebind
+	{
+		typedef cache_aligned_allocator<U> other;
+	};
+
+	cache_aligned_allocator() = default;
+
+	template<class U>
+	cache_aligned_allocator(const cache_aligned_allocator<U>&)
+	{}
+
+	T* allocate(size_t n_)
+	{
+		return static_cast<T*>(::operator new(n_ * sizeof(T), std::align_val_t(alignment)));
+	}
+
+	void deallocate(T* p_, size_t)
+	{
+		::operator delete(p_, std::align_val_t(alignment));
+	}
+
+	//stx::btree destroys its nodes through the allocator
+	template<class U>
+	void destroy(U* p_)
+	{
+		p_->~U();
+	}
+
+	template<class U>
+	bool operator==(const cache_aligned_allocator<U>&) const
+	{
+		return true;
+	}
+
+	template<class U>
+	bool operator!=(const cache_aligned_allocator<U>&) const
+	{
+		return false;
+	}
+};
+
+template<class Alloc, class = void>
+struct allocator_can_reallocate : std::false_type
+{};
+
+template<class Alloc>
+struct allocator_can_reallocate<Alloc, std::void_t<decltype(std::declval<Alloc&>().reallocate(std::declval<typename Alloc::value_type*>(), size_t(), size_t()))>> : std::true_type
+{};
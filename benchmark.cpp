@@ -1,16 +1,33 @@
+#include "allocators.h"
+#include "container_ops.h"
+#include "cuckoo_set.h"
+#include "filtered_set.h"
 #include "futils.h"
 #include "hot_set.h"
+#include "hot_set_snapshot.h"
+#include "hot_int_set.h"
+#include "hopscotch_set.h"
 #include "ht_chained.h"
+#include "perfect_set.h"
+#include "set_algebra.h"
+#include "static_ordered_set.h"
+#include "string_arena.h"
+#include "swiss_set.h"
+#include "inline_string.h"
 #include "x_hashmap/HashMap.h"
 #include "stx/btree_set.h"
 
 #include <geiger/geiger.h>
+#include <papi.h>
 
+#include <random>
 #include <set>
+#include <type_traits>
 #include <unordered_set>
 #include <google/dense_hash_set>
 #include <google/sparse_hash_set>
 #include <boost/container/flat_set.hpp>
+#include <boost/iterator/function_output_iterator.hpp>
 
 #include <cxxabi.h>
 
@@ -20,37 +37,163 @@ const std::vector<std::string>& get_dict_words()
     if (!v.empty())
         return v;
 
-    io::for_each_line(io::read_all("/etc/dictionaries-common/words"), [&v](const std::string& str)
+    io::for_each_mapped_line("/etc/dictionaries-common/words", [&v](std::string_view str)
     {
-        v.emplace_back(str);
+        if (!str.empty())
+            v.emplace_back(str);
     });
 
     return v;
 }
 
+// the same words interned into one arena, for the containers storing string_view
+const std::vector<std::string_view>& get_dict_word_views()
+{
+    static string_arena arena;
+    static std::vector<std::string_view> v;
+    if (!v.empty())
+        return v;
+
+    for (const auto& w : get_dict_words())
+        v.push_back(arena.intern(w));
+
+    return v;
+}
+
+// the words with a suffix no dictionary word has: lookups that all miss
+const std::vector<std::string>& get_dict_misses()
+{
+    static std::vector<std::string> v;
+    if (!v.empty())
+        return v;
+
+    for (const auto& w : get_dict_words())
+        v.push_back(w + "#");
+
+    return v;
+}
+
+// grows in place: realloc instead of allocate + move + deallocate
+template <typename T>
+using hov_realloc_set = hot_set<T, variable<T>, std::equal_to<void>, realloc_allocator<T>>;
+
+template <typename _MapT, typename = void>
+struct has_reserve : std::false_type {};
+
 template <typename _MapT>
-_MapT prepare_map()
+struct has_reserve<_MapT, std::void_t<decltype(std::declval<_MapT&>().reserve(size_t()))>> : std::true_type {};
+
+template <typename _MapT, typename = void>
+struct has_resize : std::false_type {};
+
+template <typename _MapT>
+struct has_resize<_MapT, std::void_t<decltype(std::declval<_MapT&>().resize(size_t()))>> : std::true_type {};
+
+template <typename _MapT>
+struct is_reservable : std::integral_constant<bool, has_reserve<_MapT>::value || has_resize<_MapT>::value> {};
+
+// pre-sizes m for n keys with reserve(), or resize() for the google sets
+template <typename _MapT>
+void reserve_map(_MapT& m, size_t n)
+{
+    if constexpr (has_reserve<_MapT>::value)
+        m.reserve(n);
+    else if constexpr (has_resize<_MapT>::value)
+        m.resize(n);
+}
+
+template <typename _MapT>
+_MapT prepare_map(bool reserve = false)
 {
     _MapT m;
+    if (reserve)
+        reserve_map(m, get_dict_words().size());
     for (const auto& v : get_dict_words())
         m.insert(v);
     return m;
 }
 
 template <>
-hov_set<std::string> prepare_map<hov_set<std::string>>()
+hov_set<std::string> prepare_map<hov_set<std::string>>(bool reserve)
 {
     hov_set<std::string> m;
+    if (reserve)
+        m.reserve(get_dict_words().size());
     for (const auto& v : get_dict_words())
         m.insert(v);
     return m;
 }
 
 template <>
-rigtorp::HashMap<std::string, int> prepare_map<rigtorp::HashMap<std::string, int>>()
+hov_set<std::string_view> prepare_map<hov_set<std::string_view>>(bool reserve)
+{
+    hov_set<std::string_view> m;
+    if (reserve)
+        m.reserve(get_dict_word_views().size());
+    for (const auto& v : get_dict_word_views())
+        m.insert(v);
+    return m;
+}
+
+template <>
+hov_realloc_set<std::string_view> prepare_map<hov_realloc_set<std::string_view>>(bool reserve)
+{
+    hov_realloc_set<std::string_view> m;
+    if (reserve)
+        m.reserve(get_dict_word_views().size());
+    for (const auto& v : get_dict_word_views())
+        m.insert(v);
+    return m;
+}
+
+template <>
+ht_chained<std::string_view> prepare_map<ht_chained<std::string_view>>(bool reserve)
+{
+    ht_chained<std::string_view> m;
+    if (reserve)
+        m.reserve(get_dict_word_views().size());
+    for (const auto& v : get_dict_word_views())
+        m.insert(v);
+    return m;
+}
+
+// words that don't fit in the slot are interned into an arena shared by all the inline_string containers
+template <typename _MapT>
+_MapT prepare_inline_map(bool reserve)
+{
+    static string_arena arena;
+    _MapT m;
+    if (reserve)
+        reserve_map(m, get_dict_words().size());
+    for (const auto& v : get_dict_words())
+        m.insert(inline_string<24>(v, arena));
+    return m;
+}
+
+template <>
+hov_set<inline_string<24>> prepare_map<hov_set<inline_string<24>>>(bool reserve)
+{
+    return prepare_inline_map<hov_set<inline_string<24>>>(reserve);
+}
+
+template <>
+ht_chained<inline_string<24>> prepare_map<ht_chained<inline_string<24>>>(bool reserve)
+{
+    return prepare_inline_map<ht_chained<inline_string<24>>>(reserve);
+}
+
+template <>
+stx::btree_set<inline_string<24>> prepare_map<stx::btree_set<inline_string<24>>>(bool reserve)
+{
+    return prepare_inline_map<stx::btree_set<inline_string<24>>>(reserve);
+}
+
+template <>
+rigtorp::HashMap<std::string, int> prepare_map<rigtorp::HashMap<std::string, int>>(bool reserve)
 {
     rigtorp::HashMap<std::string, int> m(1, "");
-    m.reserve(get_dict_words().size());
+    if (reserve)
+        m.reserve(get_dict_words().size());
 
     for (const auto& v : get_dict_words())
         m.emplace(v, 0);
@@ -58,17 +201,40 @@ rigtorp::HashMap<std::string, int> prepare_map<rigtorp::HashMap<std::string, int
 }
 
 template <>
-google::dense_hash_set<std::string> prepare_map<google::dense_hash_set<std::string>>()
+google::dense_hash_set<std::string> prepare_map<google::dense_hash_set<std::string>>(bool reserve)
 {
     google::dense_hash_set<std::string> m;
     m.set_empty_key("");
     m.set_deleted_key("-");
+    if (reserve)
+        m.resize(get_dict_words().size());
 
     for (const auto& v : get_dict_words())
         m.insert(v);
     return m;
 }
 
+template <>
+perfect_set<std::string> prepare_map<perfect_set<std::string>>(bool)
+{
+    const auto& words = get_dict_words();
+    return perfect_set<std::string>(words.begin(), words.end());
+}
+
+template <>
+eytzinger_set<std::string> prepare_map<eytzinger_set<std::string>>(bool)
+{
+    const auto& words = get_dict_words();
+    return eytzinger_set<std::string>(words.begin(), words.end());
+}
+
+template <>
+veb_set<std::string> prepare_map<veb_set<std::string>>(bool)
+{
+    const auto& words = get_dict_words();
+    return veb_set<std::string>(words.begin(), words.end());
+}
+
 template <typename _MapT>
 std::string get_name()
 {
@@ -83,6 +249,49 @@ std::string get_name()
     return ret;
 }
 
+// times building the container from scratch, and again pre-sized for the word
+// count when the container can reserve
+template <typename _MapT, typename... Args>
+void add_build_test(geiger::suite<Args...>& s)
+{
+    get_dict_words();
+
+    s.add(std::string("build: ") + get_name<_MapT>(), []()
+    {
+        auto m = prepare_map<_MapT>();
+    });
+
+    if constexpr (is_reservable<_MapT>::value)
+    {
+        s.add(std::string("build (reserved): ") + get_name<_MapT>(), []()
+        {
+            auto m = prepare_map<_MapT>(true);
+        });
+    }
+}
+
+// startup from a snapshot against the build above: the set is saved once and
+// checked against the words, every run maps the file and copies the slots out
+template <typename _MapT, typename... Args>
+void add_snapshot_test(geiger::suite<Args...>& s)
+{
+    const auto& words = get_dict_words();
+    std::string filename = "/tmp/benchmark.snapshot";
+    snapshot::save(prepare_map<_MapT>(), filename);
+
+    _MapT check;
+    snapshot::load(filename, check);
+    assert(check.size() == words.size());
+    assert(std::all_of(words.begin(), words.end(), [&check](const std::string& v) { return check.contains(v); }));
+
+    s.add(std::string("snapshot load: ") + get_name<_MapT>(), [filename, &words]()
+    {
+        _MapT m;
+        snapshot::load(filename, m);
+        assert(m.size() == words.size());
+    });
+}
+
 template <typename _MapT, typename... Args>
 void add_insert_test(geiger::suite<Args...>& s)
 {
@@ -102,11 +311,26 @@ void add_insert_test(geiger::suite<Args...>& s)
     });
 }
 
+template <typename _MapT>
+void insert_word(_MapT& m, const std::string& v)
+{
+    m.insert(v);
+}
+
+template <>
+void insert_word<rigtorp::HashMap<std::string, int>>(rigtorp::HashMap<std::string, int>& m, const std::string& v)
+{
+    m.emplace(v, 0);
+}
+
+// erases every word and puts it back, so that each run starts from the full
+// container and the erase path is timed together with reinsertion over the
+// holes it leaves (tombstones, emptied neighbourhoods)
 template <typename _MapT, typename... Args>
 void add_erase_test(geiger::suite<Args...>& s)
 {
     auto m = prepare_map<_MapT>();
-    std::string test_name = std::string("delete: ") + get_name<_MapT>();
+    std::string test_name = std::string("delete + reinsert: ") + get_name<_MapT>();
 
     s.add(test_name, [mn = std::move(m)]() mutable
     {
@@ -114,6 +338,462 @@ void add_erase_test(geiger::suite<Args...>& s)
 
         for (const auto& v : values)
             mn.erase(v);
+        assert(mn.size() == 0);
+        for (const auto& v : values)
+            insert_word(mn, v);
+    });
+}
+
+// membership of every word, through container_ops so that the static sets,
+// which have no iterators, compare with the others
+template <typename _MapT, typename... Args>
+void add_lookup_test(geiger::suite<Args...>& s)
+{
+    auto m = std::make_shared<_MapT>(prepare_map<_MapT>());
+
+    s.add(std::string("lookup: ") + get_name<_MapT>(), [m]()
+    {
+        size_t found = 0;
+        for (const auto& v : get_dict_words())
+            found += container_ops::contains(*m, v);
+        assert(found == get_dict_words().size());
+        asm volatile("" : : "r"(found));
+    });
+}
+
+// unsuccessful lookups only, the case a filter in front of the set is for
+template <typename _MapT, typename... Args>
+void add_miss_test(geiger::suite<Args...>& s)
+{
+    auto m = std::make_shared<_MapT>(prepare_map<_MapT>());
+    get_dict_misses();
+
+    s.add(std::string("miss: ") + get_name<_MapT>(), [m]()
+    {
+        size_t found = 0;
+        for (const auto& v : get_dict_misses())
+            found += container_ops::contains(*m, v);
+        assert(found == 0);
+        asm volatile("" : : "r"(found));
+    });
+}
+
+// expiry sweep removing the words of even length: erased one by one, with one
+// erase_if pass, or by rebuilding a set from the survivors. the first two start
+// from a copy of the full set, timed alone as "sweep, copy"
+template <typename... Args>
+void add_sweep_tests(geiger::suite<Args...>& s)
+{
+    typedef hov_set<std::string> set_type;
+    auto m = std::make_shared<set_type>(prepare_map<set_type>());
+    auto expired = [](const std::string& w) { return w.size() % 2 == 0; };
+    std::string name = get_name<set_type>();
+
+    s.add("sweep, copy: " + name, [m]()
+    {
+        auto c = *m;
+    });
+
+    s.add("sweep, erase loop: " + name, [m, expired]()
+    {
+        auto c = *m;
+        for (const auto& v : get_dict_words())
+        {
+            if (expired(v))
+                c.erase(v);
+        }
+    });
+
+    s.add("sweep, erase_if: " + name, [m, expired]()
+    {
+        auto c = *m;
+        c.erase_if(expired);
+    });
+
+    s.add("sweep, rebuild: " + name, [m, expired]()
+    {
+        set_type c;
+        m->for_each([&](const std::string& v)
+        {
+            if (!expired(v))
+                c.insert(v);
+        });
+    });
+}
+
+// random 64-bit keys, for tables larger than what the TLB covers with 4KB pages
+const std::vector<uint64_t>& get_random_keys()
+{
+    static std::vector<uint64_t> v;
+    if (!v.empty())
+        return v;
+
+    std::mt19937_64 rng(42);
+    v.resize(size_t(1) << 21);
+    for (auto& k : v)
+        k = rng() | 1;
+
+    return v;
+}
+
+// the same keys in another order, so consecutive lookups hit unrelated pages
+const std::vector<uint64_t>& get_random_lookups()
+{
+    static std::vector<uint64_t> v;
+    if (!v.empty())
+        return v;
+
+    v = get_random_keys();
+    std::shuffle(v.begin(), v.end(), std::mt19937_64(7));
+
+    return v;
+}
+
+template <typename Alloc>
+using int_hot_set = hot_set<uint64_t, std::integral_constant<uint64_t, 0>, std::equal_to<void>, Alloc>;
+
+template <typename Alloc>
+using int_ht_chained = ht_chained<uint64_t, std::hash<uint64_t>, no_instrumentation, Alloc>;
+
+template <typename Alloc>
+using int_btree_set = stx::btree_set<uint64_t, std::less<uint64_t>, stx::btree_default_set_traits<uint64_t>, Alloc>;
+
+// random lookups in a large table, to compare TLB misses between allocators
+template <typename _SetT, typename... Args>
+void add_tlb_test(geiger::suite<Args...>& s)
+{
+    auto m = std::make_shared<_SetT>();
+    for (auto k : get_random_keys())
+        m->insert(k);
+    get_random_lookups();
+
+    s.add(std::string("tlb lookup: ") + get_name<_SetT>(), [m]()
+    {
+        size_t found = 0;
+        for (auto k : get_random_lookups())
+            found += container_ops::contains(*m, k);
+        assert(found == get_random_keys().size());
+        asm volatile("" : : "r"(found));
+    });
+}
+
+// intersection of a large set of random keys with one ratio times smaller, half
+// of whose keys are in the large one: loops of finds against the strategies of
+// set_algebra.h, for hashed sets, btrees and sorted arrays
+template <typename... Args>
+void add_set_algebra_tests(geiger::suite<Args...>& s, size_t ratio)
+{
+    const auto& keys = get_random_keys();
+    size_t large_size = keys.size() / 2;
+    size_t small_size = large_size / ratio;
+
+    std::vector<uint64_t> large(keys.begin(), keys.begin() + large_size);
+    std::vector<uint64_t> small(keys.begin() + large_size - small_size / 2, keys.begin() + large_size - small_size / 2 + small_size);
+
+    auto hl = std::make_shared<hot_int_set<uint64_t>>();
+    auto hs = std::make_shared<hot_int_set<uint64_t>>();
+    auto bl = std::make_shared<stx::btree_set<uint64_t>>(large.begin(), large.end());
+    auto bs = std::make_shared<stx::btree_set<uint64_t>>(small.begin(), small.end());
+    for (auto k : large)
+        hl->insert(k);
+    for (auto k : small)
+        hs->insert(k);
+    std::sort(large.begin(), large.end());
+    std::sort(small.begin(), small.end());
+    auto al = std::make_shared<std::vector<uint64_t>>(std::move(large));
+    auto as = std::make_shared<std::vector<uint64_t>>(std::move(small));
+
+    std::string name = "intersect 1:" + std::to_string(ratio) + ", ";
+    size_t expected = small_size / 2;
+
+    s.add(name + "find loop: hot_int_set", [hl, hs, expected]()
+    {
+        uint64_t sum = 0;
+        size_t found = 0;
+        for (auto k : *hs)
+        {
+            if (hl->contains(k))
+            {
+                sum += k;
+                ++found;
+            }
+        }
+        assert(found == expected);
+        asm volatile("" : : "r"(found), "r"(sum));
+    });
+
+    s.add(name + "hashed_intersection: hot_int_set", [hl, hs, expected]()
+    {
+        uint64_t sum = 0;
+        size_t found = set_algebra::hashed_intersection(*hl, *hs, [&](uint64_t k) { sum += k; });
+        assert(found == expected);
+        asm volatile("" : : "r"(found), "r"(sum));
+    });
+
+    s.add(name + "find loop: btree_set", [bl, bs, expected]()
+    {
+        uint64_t sum = 0;
+        size_t found = 0;
+        for (auto it = bs->begin(); it != bs->end(); ++it)
+        {
+            if (bl->count(it.key()))
+            {
+                sum += it.key();
+                ++found;
+            }
+        }
+        assert(found == expected);
+        asm volatile("" : : "r"(found), "r"(sum));
+    });
+
+    s.add(name + "merge_intersection: btree_set", [bl, bs, expected]()
+    {
+        uint64_t sum = 0;
+        size_t found = set_algebra::merge_intersection(*bl, *bs, [&](uint64_t k) { sum += k; });
+        assert(found == expected);
+        asm volatile("" : : "r"(found), "r"(sum));
+    });
+
+    // walks a btree_set, whose iterators hand out a copy of the key, while
+    // batching probes into the hash set
+    s.add(name + "hashed_difference: btree_set against hot_int_set", [hl, bs, small_size, expected]()
+    {
+        uint64_t sum = 0;
+        size_t missing = set_algebra::hashed_difference(*bs, *hl, [&](uint64_t k) { sum += k; });
+        assert(missing == small_size - expected);
+        asm volatile("" : : "r"(missing), "r"(sum));
+    });
+
+    s.add(name + "std::set_intersection: sorted array", [al, as, expected]()
+    {
+        uint64_t sum = 0;
+        size_t found = 0;
+        auto out = [&](uint64_t k) { sum += k; ++found; };
+        std::set_intersection(al->begin(), al->end(), as->begin(), as->end(), boost::make_function_output_iterator(out));
+        assert(found == expected);
+        asm volatile("" : : "r"(found), "r"(sum));
+    });
+
+    s.add(name + "sorted_intersection: sorted array", [al, as, expected]()
+    {
+        uint64_t sum = 0;
+        size_t found = set_algebra::sorted_intersection(al->data(), al->size(), as->data(), as->size(), [&](uint64_t k) { sum += k; });
+        assert(found == expected);
+        asm volatile("" : : "r"(found), "r"(sum));
+    });
+}
+
+// compacting a delta of random keys into a large btree: inserts one by one
+// against merge(), and join() when the delta lies past the base. every test
+// copies the base first, "copy" measures that alone
+template <typename... Args>
+void add_btree_merge_tests(geiger::suite<Args...>& s)
+{
+    typedef stx::btree_set<uint64_t> set_type;
+    const auto& keys = get_random_keys();
+    size_t base_size = keys.size() / 2;
+    size_t delta_size = base_size / 4;
+
+    std::vector<uint64_t> sorted(keys.begin(), keys.begin() + base_size + delta_size);
+    std::sort(sorted.begin(), sorted.end());
+
+    auto base = std::make_shared<set_type>(keys.begin(), keys.begin() + base_size);
+    auto delta = std::make_shared<set_type>(keys.begin() + base_size, keys.begin() + base_size + delta_size);
+    auto low = std::make_shared<set_type>();
+    auto high = std::make_shared<set_type>();
+    low->bulk_load(sorted.begin(), sorted.begin() + base_size);
+    high->bulk_load(sorted.begin() + base_size, sorted.end());
+
+    s.add("btree merge, copy", [base, delta]()
+    {
+        set_type b(*base), d(*delta);
+    });
+
+    s.add("btree merge, insert loop", [base, delta]()
+    {
+        set_type b(*base), d(*delta);
+        for (auto it = d.begin(); it != d.end(); ++it)
+            b.insert(it.key());
+        assert(b.size() == base->size() + delta->size());
+    });
+
+    s.add("btree merge, merge", [base, delta]()
+    {
+        set_type b(*base), d(*delta);
+        b.merge(d);
+        assert(b.size() == base->size() + delta->size());
+    });
+
+    s.add("btree merge, disjoint insert loop", [low, high]()
+    {
+        set_type b(*low), d(*high);
+        for (auto it = d.begin(); it != d.end(); ++it)
+            b.insert(it.key());
+        assert(b.size() == low->size() + high->size());
+    });
+
+    s.add("btree merge, disjoint join", [low, high]()
+    {
+        set_type b(*low), d(*high);
+        b.join(d);
+        assert(b.size() == low->size() + high->size());
+    });
+
+    s.add("btree merge, split", [low]()
+    {
+        set_type b(*low), r;
+        b.split(*low->lower_bound(uint64_t(1) << 63), r);
+        assert(b.size() + r.size() == low->size());
+    });
+}
+
+// expiring the oldest keys of a large btree, as a time window does, by erasing
+// them one by one and with erase(first, last), and counting the keys of random
+// windows by walking them and with count_range() on a tree keeping subtree
+// counts; the two insert loops show what keeping the counts costs
+struct btree_counted_traits : stx::btree_default_set_traits<uint64_t>
+{
+    static const bool order_statistics = true;
+};
+
+template <typename... Args>
+void add_btree_range_tests(geiger::suite<Args...>& s)
+{
+    typedef stx::btree_set<uint64_t> set_type;
+    typedef stx::btree_set<uint64_t, std::less<uint64_t>, btree_counted_traits> counted_type;
+    const auto& keys = get_random_keys();
+    size_t base_size = keys.size() / 2;
+    size_t delta_size = base_size / 4;
+
+    std::vector<uint64_t> sorted(keys.begin(), keys.begin() + base_size);
+    std::sort(sorted.begin(), sorted.end());
+
+    auto base = std::make_shared<set_type>();
+    auto counted = std::make_shared<counted_type>();
+    base->bulk_load(sorted.begin(), sorted.end());
+    counted->bulk_load(sorted.begin(), sorted.end());
+
+    // an eighth of the keys expire
+    uint64_t cutoff = sorted[base_size / 8];
+    size_t remaining = base->size() - base_size / 8;
+
+    std::vector<std::pair<uint64_t, uint64_t>> windows;
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        uint64_t lo = keys[i], hi = keys[i + 1000];
+        windows.emplace_back(std::min(lo, hi), std::max(lo, hi));
+    }
+
+    size_t expected = 0;
+    for (auto& w : windows)
+        expected += std::distance(base->lower_bound(w.first), base->lower_bound(w.second));
+
+    s.add("btree range, copy", [base]()
+    {
+        set_type b(*base);
+    });
+
+    s.add("btree range, expire erase loop", [base, cutoff, remaining]()
+    {
+        set_type b(*base);
+        while (!b.empty() && *b.begin() < cutoff)
+            b.erase(b.begin());
+        assert(b.size() == remaining);
+    });
+
+    s.add("btree range, expire erase range", [base, cutoff, remaining]()
+    {
+        set_type b(*base);
+        b.erase(b.begin(), b.lower_bound(cutoff));
+        assert(b.size() == remaining);
+    });
+
+    s.add("btree range, count walk", [base, windows, expected]()
+    {
+        size_t total = 0;
+        for (auto& w : windows)
+            total += std::distance(base->lower_bound(w.first), base->lower_bound(w.second));
+        assert(total == expected);
+        asm volatile("" : : "r"(total));
+    });
+
+    s.add("btree range, count_range", [counted, windows, expected]()
+    {
+        size_t total = 0;
+        for (auto& w : windows)
+            total += counted->count_range(w.first, w.second);
+        assert(total == expected);
+        asm volatile("" : : "r"(total));
+    });
+
+    s.add("btree range, insert loop", [&keys, base_size, delta_size]()
+    {
+        set_type b;
+        for (size_t i = base_size; i < base_size + delta_size; ++i)
+            b.insert(keys[i]);
+    });
+
+    s.add("btree range, insert loop counted", [&keys, base_size, delta_size]()
+    {
+        counted_type b;
+        for (size_t i = base_size; i < base_size + delta_size; ++i)
+            b.insert(keys[i]);
+    });
+}
+
+// loading the dictionary file into sets of views into its mapping: one thread
+// over all lines, against the lines cut on line boundaries and hashed into one
+// partition per thread, each partition then loaded into its own set
+template <typename... Args>
+void add_ingest_tests(geiger::suite<Args...>& s)
+{
+    typedef hov_set<std::string_view> set_type;
+    auto file = std::make_shared<io::mapped_file>("/etc/dictionaries-common/words");
+    size_t nthreads = std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+    size_t expected = get_dict_words().size();
+
+    s.add("ingest: for_each_line_view, 1 thread", [file, expected]()
+    {
+        set_type set;
+        io::for_each_line_view(file->view(), [&set](std::string_view line)
+        {
+            if (!line.empty())
+                set.insert(line);
+        });
+        assert(set.size() == expected);
+        asm volatile("" : : "r"(set.size()));
+    });
+
+    s.add("ingest: parallel_for_each_line, " + std::to_string(nthreads) + " threads", [file, nthreads, expected]()
+    {
+        // per-thread staging, as a partitioned loader would fill
+        std::vector<std::vector<std::string_view>> staging(nthreads);
+        io::parallel_for_each_line(file->view(), nthreads, [&staging](size_t t, std::string_view line)
+        {
+            if (!line.empty())
+                staging[t].push_back(line);
+        });
+        size_t total = 0;
+        for (auto& v : staging)
+            total += v.size();
+        assert(total == expected);
+        asm volatile("" : : "r"(total));
+    });
+
+    s.add("ingest: parallel_partition_lines, " + std::to_string(nthreads) + " threads", [file, nthreads, expected]()
+    {
+        auto partitions = io::parallel_partition_lines(file->view(), nthreads, nthreads);
+        std::vector<set_type> sets(partitions.size());
+        io::parallel_for_each_index(partitions.size(), [&](size_t p)
+        {
+            for (auto line : partitions[p])
+                sets[p].insert(line);
+        });
+        size_t total = 0;
+        for (auto& set : sets)
+            total += set.size();
+        assert(total == expected);
+        asm volatile("" : : "r"(total));
     });
 }
 
@@ -131,19 +811,91 @@ int main()
     add_insert_test<stx::btree_set<std::string>>(s);
     add_insert_test<hov_set<std::string>>(s);
     add_insert_test<ht_chained<std::string>>(s);
+    add_insert_test<cuckoo_set<std::string>>(s);
+    add_insert_test<swiss_set<std::string>>(s);
+    add_insert_test<hopscotch_set<std::string>>(s);
+    add_insert_test<hov_set<std::string_view>>(s);
+    add_insert_test<ht_chained<std::string_view>>(s);
+    add_insert_test<hov_set<inline_string<24>>>(s);
+    add_insert_test<ht_chained<inline_string<24>>>(s);
+    add_insert_test<stx::btree_set<inline_string<24>>>(s);
     add_insert_test<rigtorp::HashMap<std::string, int>>(s);
 
-    /*
+    add_build_test<std::set<std::string>>(s);
+    add_build_test<std::unordered_set<std::string>>(s);
+    add_build_test<google::dense_hash_set<std::string>>(s);
+    add_build_test<google::sparse_hash_set<std::string>>(s);
+    add_build_test<boost::container::flat_set<std::string>>(s);
+    add_build_test<stx::btree_set<std::string>>(s);
+    add_build_test<hov_set<std::string>>(s);
+    add_snapshot_test<hov_set<std::string>>(s);
+    add_build_test<ht_chained<std::string>>(s);
+    add_build_test<cuckoo_set<std::string>>(s);
+    add_build_test<swiss_set<std::string>>(s);
+    add_build_test<hopscotch_set<std::string>>(s);
+    add_build_test<perfect_set<std::string>>(s);
+    add_build_test<hov_set<std::string_view>>(s);
+    add_build_test<hov_realloc_set<std::string_view>>(s);
+    add_build_test<ht_chained<std::string_view>>(s);
+    add_build_test<hov_set<inline_string<24>>>(s);
+    add_build_test<ht_chained<inline_string<24>>>(s);
+    add_build_test<stx::btree_set<inline_string<24>>>(s);
+    add_build_test<rigtorp::HashMap<std::string, int>>(s);
+
+    add_lookup_test<boost::container::flat_set<std::string>>(s);
+    add_lookup_test<stx::btree_set<std::string>>(s);
+    add_lookup_test<eytzinger_set<std::string>>(s);
+    add_lookup_test<veb_set<std::string>>(s);
+    add_lookup_test<hov_set<std::string>>(s);
+    add_lookup_test<swiss_set<std::string>>(s);
+    add_lookup_test<perfect_set<std::string>>(s);
+
+    add_miss_test<hov_set<std::string>>(s);
+    add_miss_test<filtered_set<hov_set<std::string>>>(s);
+    add_miss_test<filtered_set<hov_set<std::string>, counting_bloom_filter>>(s);
+    add_miss_test<stx::btree_set<std::string>>(s);
+    add_miss_test<filtered_set<stx::btree_set<std::string>>>(s);
+    add_miss_test<std::unordered_set<std::string>>(s);
+    add_miss_test<filtered_set<std::unordered_set<std::string>>>(s);
+
+    add_sweep_tests(s);
+    add_btree_merge_tests(s);
+    add_btree_range_tests(s);
+    add_ingest_tests(s);
+
     add_erase_test<std::set<std::string>>(s);
     add_erase_test<std::unordered_set<std::string>>(s);
     add_erase_test<google::dense_hash_set<std::string>>(s);
-    add_erase_test<boost::container::flat_set<std::string>>(s);
+    // no flat_set: erasing the words one by one shifts the whole array each time
     add_erase_test<hov_set<std::string>>(s);
+    add_erase_test<cuckoo_set<std::string>>(s);
+    add_erase_test<swiss_set<std::string>>(s);
+    add_erase_test<hopscotch_set<std::string>>(s);
     add_erase_test<rigtorp::HashMap<std::string, int>>(s);
-    */
 
     s.run();
 
+    geiger::suite<geiger::papi_wrapper<PAPI_TLB_DM>> tlb;
+    tlb.set_printer<geiger::printer::console<>>();
+
+    add_tlb_test<int_hot_set<std::allocator<uint64_t>>>(tlb);
+    add_tlb_test<int_hot_set<huge_page_allocator<uint64_t>>>(tlb);
+    add_tlb_test<hot_int_set<uint64_t>>(tlb);
+    add_tlb_test<int_ht_chained<std::allocator<uint64_t>>>(tlb);
+    add_tlb_test<int_ht_chained<huge_page_allocator<uint64_t>>>(tlb);
+    add_tlb_test<int_btree_set<std::allocator<uint64_t>>>(tlb);
+    add_tlb_test<int_btree_set<huge_page_allocator<uint64_t>>>(tlb);
+
+    tlb.run();
+
+    geiger::suite<> algebra;
+    algebra.set_printer<geiger::printer::console<>>();
+
+    for (size_t ratio : { 1, 16, 256 })
+        add_set_algebra_tests(algebra, ratio);
+
+    algebra.run();
+
 	return 0;
 }
 
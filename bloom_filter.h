@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "allocators.h"
+
+//approximate membership filters over 64-bit hashes, to put in front of a set
+//whose misses are expensive (see filtered_set). a filter never answers false
+//for a hash it holds; for other hashes it answers true with a small probability
+//
+//both are blocked: the hash picks one block from its high bits and all the
+//cells it sets or tests lie in that block, so a query costs one cache miss
+//whatever the number of cells. within a block the low 32 bits of the hash,
+//multiplied by eight odd constants, pick one cell in each of eight words (the
+//split block layout of Impala and Parquet)
+
+namespace bloom
+{
+
+namespace detail
+{
+
+static const uint32_t salt[8] = { 0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du, 0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u };
+
+inline uint64_t fastrange(uint64_t x, uint64_t n)
+{
+	return uint64_t((__uint128_t(x) * n) >> 64);
+}
+
+inline size_t block_count(size_t expected_, size_t cells_per_key_, size_t cells_per_block_)
+{
+	auto cells = (expected_ > 0 ? expected_ : 1) * cells_per_key_;
+	return (cells + cells_per_block_ - 1) / cells_per_block_;
+}
+
+}
+
+}
+
+//split block Bloom filter: 256-bit blocks of eight 32-bit words, one bit set
+//per word. with the default 12 bits per key about 0.5% of absent hashes pass.
+//with AVX2 a query is a multiply, a shift and one vptest against the block
+class blocked_bloom_filter
+{
+	struct alignas(32) block
+	{
+		uint32_t words[8];
+	};
+
+	std::vector<block, cache_aligned_allocator<block>> mblocks;
+
+	block& block_of(uint64_t hash_)
+	{
+		return mblocks[bloom::detail::fastrange(hash_, mblocks.size())];
+	}
+
+	const block& block_of(uint64_t hash_) const
+	{
+		return mblocks[bloom::detail::fastrange(hash_, mblocks.size())];
+	}
+
+#ifdef __AVX2__
+	static __m256i mask(uint64_t hash_)
+	{
+		auto salt = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bloom::detail::salt));
+		auto bits = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(int(uint32_t(hash_))), salt), 27);
+		return _mm256_sllv_epi32(_mm256_set1_epi32(1), bits);
+	}
+#endif
+
+public:
+	static constexpr bool supports_erase = false;
+
+	enum : size_t { bits_per_block = 256 };
+
+	//sized for expected_ keys at bits_per_key_ bits each
+	explicit blocked_bloom_filter(size_t expected_ = 0, size_t bits_per_key_ = 12)
+		: mblocks(bloom::detail::block_count(expected_, bits_per_key_, bits_per_block))
+	{}
+
+	void insert(uint64_t hash_)
+	{
+		auto& b = block_of(hash_);
+#ifdef __AVX2__
+		auto p = reinterpret_cast<__m256i*>(b.words);
+		_mm256_store_si256(p, _mm256_or_si256(_mm256_load_si256(p), mask(hash_)));
+#else
+		for (int i = 0; i < 8; ++i)
+			b.words[i] |= uint32_t(1) << ((uint32_t(hash_) * bloom::detail::salt[i]) >> 27);
+#endif
+	}
+
+	//false if hash_ was never inserted
+	bool may_contain(uint64_t hash_) const
+	{
+		auto& b = block_of(hash_);
+#ifdef __AVX2__
+		return _mm256_testc_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(b.words)), mask(hash_));
+#else
+		uint32_t missing = 0;
+		for (int i = 0; i < 8; ++i)
+			missing |= ~b.words[i] & (uint32_t(1) << ((uint32_t(hash_) * bloom::detail::salt[i]) >> 27));
+		return missing == 0;
+#endif
+	}
+
+	void clear()
+	{
+		std::fill(mblocks.begin(), mblocks.end(), block());
+	}
+
+	size_t bytes() const
+	{
+		return mblocks.size() * sizeof(block);
+	}
+};
+
+//blocked counting Bloom filter, for sets that erase: 64-byte blocks of eight
+//64-bit words holding 16 four-bit counters each, one counter per word per key.
+//erase decrements them again. a counter that reaches 15 sticks there, since its
+//true count is lost; it only costs a little accuracy. four bits per cell make it
+//four times the size of blocked_bloom_filter for the same number of cells per
+//key, with a slightly higher false positive rate (counters are spread over 16
+//positions per word instead of 32)
+class counting_bloom_filter
+{
+	struct alignas(64) block
+	{
+		uint64_t words[8];
+	};
+
+	std::vector<block, cache_aligned_allocator<block>> mblocks;
+
+	block& block_of(uint64_t hash_)
+	{
+		return mblocks[bloom::detail::fastrange(hash_, mblocks.size())];
+	}
+
+	const block& block_of(uint64_t hash_) const
+	{
+		return mblocks[bloom::detail::fastrange(hash_, mblocks.size())];
+	}
+
+	//bit offset of the key's counter in word i_
+	static unsigned shift(uint64_t hash_, int i_)
+	{
+		return ((uint32_t(hash_) * bloom::detail::salt[i_]) >> 28) * 4;
+	}
+
+public:
+	static constexpr bool supports_erase = true;
+
+	enum : size_t { counters_per_block = 128 };
+
+	//sized for expected_ keys at counters_per_key_ counters each
+	explicit counting_bloom_filter(size_t expected_ = 0, size_t counters_per_key_ = 12)
+		: mblocks(bloom::detail::block_count(expected_, counters_per_key_, counters_per_block))
+	{}
+
+	void insert(uint64_t hash_)
+	{
+		auto& b = block_of(hash_);
+		for (int i = 0; i < 8; ++i)
+		{
+			auto s = shift(hash_, i);
+			if (((b.words[i] >> s) & 15) != 15)
+				b.words[i] += uint64_t(1) << s;
+		}
+	}
+
+	//hash_ must have been inserted, and not erased since
+	void erase(uint64_t hash_)
+	{
+		auto& b = block_of(hash_);
+		for (int i = 0; i < 8; ++i)
+		{
+			auto s = shift(hash_, i);
+			auto c = (b.words[i] >> s) & 15;
+			if (c != 15 && c != 0)
+				b.words[i] -= uint64_t(1) << s;
+		}
+	}
+
+	//false if hash_ was never inserted, or erased as many times as inserted
+	bool may_contain(uint64_t hash_) const
+	{
+		auto& b = block_of(hash_);
+		bool all = true;
+		for (int i = 0; i < 8; ++i)
+			all &= ((b.words[i] >> shift(hash_, i)) & 15) != 0;
+		return all;
+	}
+
+	void clear()
+	{
+		std::fill(mblocks.begin(), mblocks.end(), block());
+	}
+
+	size_t bytes() const
+	{
+		return mblocks.size() * sizeof(block);
+	}
+};
@@ -0,0 +1,97 @@
+#include "futils.h"
+#include "hot_set.h"
+#include "ht_chained.h"
+#include "sharded_set.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// usage: concurrent_benchmark [max threads]
+// write-heavy mix on random keys: 40% insert, 40% erase, 20% lookup
+
+typedef hot_set<uint64_t, std::integral_constant<uint64_t, 0>> int_hot_set;
+
+const uint64_t key_range = uint64_t(1) << 20;
+const size_t ops_per_thread = size_t(1) << 21;
+
+// one op per 64-bit draw: the low byte picks the operation, the rest the key
+std::vector<uint64_t> make_ops(size_t thread)
+{
+    std::mt19937_64 rng(thread + 1);
+    std::vector<uint64_t> ops(ops_per_thread);
+    for (auto& op : ops)
+        op = rng();
+    return ops;
+}
+
+template <typename _SetT>
+double run(_SetT& set, size_t nthreads)
+{
+    std::vector<std::vector<uint64_t>> ops(nthreads);
+    for (size_t i = 0; i < nthreads; ++i)
+        ops[i] = make_ops(i);
+
+    std::vector<size_t> hits(nthreads);
+    auto start = std::chrono::steady_clock::now();
+    io::parallel_for_each_index(nthreads, [&](size_t i)
+    {
+        size_t h = 0;
+        for (auto op : ops[i])
+        {
+            uint64_t key = ((op >> 8) % key_range) + 1;
+            unsigned kind = op & 0xff;
+            if (kind < 102)
+                h += set.insert(key);
+            else if (kind < 204)
+                h += set.erase(key);
+            else
+                h += set.contains(key);
+        }
+        hits[i] = h;
+    });
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    asm volatile("" : : "r"(hits.data()) : "memory");
+
+    return double(nthreads * ops_per_thread) / std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+template <typename _SetT>
+void bench(const char* label, size_t shards, const std::vector<size_t>& thread_counts)
+{
+    std::printf("%-34s", label);
+    for (auto n : thread_counts)
+    {
+        _SetT set(shards);
+        std::printf("%10.2f", run(set, n));
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    size_t max_threads = argc > 1 ? size_t(std::max(1, std::atoi(argv[1]))) : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<size_t> thread_counts;
+    for (size_t n = 1; n < max_threads; n *= 2)
+        thread_counts.push_back(n);
+    thread_counts.push_back(max_threads);
+
+    std::printf("Mops/s, %zu keys, 40%% insert / 40%% erase / 20%% lookup\n", size_t(key_range));
+    std::printf("%-34s", "threads");
+    for (auto n : thread_counts)
+        std::printf("%10zu", n);
+    std::printf("\n");
+
+    bench<sharded_set<int_hot_set>>("hot_set, one lock", 1, thread_counts);
+    bench<sharded_set<int_hot_set>>("hot_set, 64 shards", 64, thread_counts);
+    bench<sharded_set<ht_chained<uint64_t>>>("ht_chained, 64 shards", 64, thread_counts);
+    bench<sharded_set<std::unordered_set<uint64_t>>>("std::unordered_set, one lock", 1, thread_counts);
+    bench<sharded_set<std::unordered_set<uint64_t>>>("std::unordered_set, 64 shards", 64, thread_counts);
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include "hot_set.h"
+
+//uniform membership operations over the sets in this repo and the third-party
+//ones in benchmark.cpp, which disagree on names and return types:
+//hot_set::insert returns (slot, already present), ht_chained::find returns a
+//bool, the std and google sets return iterators and counts
+
+namespace container_ops
+{
+
+namespace detail
+{
+
+template<class C, class = void>
+struct has_key_type : std::false_type
+{};
+
+template<class C>
+struct has_key_type<C, std::void_t<typename C::key_type>> : std::true_type
+{};
+
+template<class C, class K, class = void>
+struct has_contains : std::false_type
+{};
+
+template<class C, class K>
+struct has_contains<C, K, std::void_t<decltype(std::declval<const C&>().contains(std::declval<const K&>()))>> : std::true_type
+{};
+
+template<class C, class K, class = void>
+struct find_returns_bool : std::false_type
+{};
+
+template<class C, class K>
+struct find_returns_bool<C, K, std::void_t<decltype(std::declval<const C&>().find(std::declval<const K&>()))>>
+	: std::is_same<decltype(std::declval<const C&>().find(std::declval<const K&>())), bool>
+{};
+
+template<class C, bool = has_key_type<C>::value>
+struct key_of
+{
+	typedef typename C::key_type type;
+};
+
+template<class C>
+struct key_of<C, false>
+{
+	typedef typename C::value_type type;
+};
+
+}
+
+//key_type, or value_type for hot_set which has no key_type
+template<class C>
+using key_type_t = typename detail::key_of<C>::type;
+
+template<class C, class K>
+bool contains(const C& c_, const K& key_)
+{
+	if constexpr (detail::has_contains<C, K>::value)
+		return c_.contains(key_);
+	else if constexpr (detail::find_returns_bool<C, K>::value)
+		return c_.find(key_);
+	else
+		return c_.count(key_) != 0;
+}
+
+//true if key_ was not in c_ before
+template<class C, class K>
+bool insert(C& c_, K&& key_)
+{
+	if constexpr (std::is_void<decltype(c_.insert(std::forward<K>(key_)))>::value)
+	{
+		bool present = contains(c_, key_);
+		c_.insert(std::forward<K>(key_));
+		return !present;
+	}
+	else
+	{
+		return c_.insert(std::forward<K>(key_)).second;
+	}
+}
+
+template<class T, class Tomb, class Equal, class Alloc, class Hash, class Load, class Instr, class K>
+bool insert(hot_set<T, Tomb, Equal, Alloc, Hash, Load, Instr>& c_, K&& key_)
+{
+	return !c_.insert(std::forward<K>(key_)).second;
+}
+
+//true if key_ was in c_
+template<class C, class K>
+bool erase(C& c_, const K& key_)
+{
+	return c_.erase(key_) != 0;
+}
+
+}
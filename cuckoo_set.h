@@ -0,0 +1,605 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hash_functions.h"
+#include "hot_set.h"
+
+//a cuckoo table reaches ~95% load with two buckets of four slots before an
+//insert fails; growing at 90% keeps the eviction searches short
+struct cuckoo_load_policy : default_load_policy
+{
+	size_t occupancy(size_t allocated)
+	{
+		return allocated - allocated / 10;
+	}
+
+	size_t allocated(size_t occupied)
+	{
+		if (occupied == 0)
+			return 0;
+		size_t n = 32;
+		while (occupancy(n) < occupied)
+			n <<= 1;
+		return n;
+	}
+};
+
+//bucketised cuckoo hashing: every element lives in one of two buckets of four
+//slots, chosen from its hash, so a lookup reads two fingerprint words and
+//compares keys only where the 8-bit fingerprint matches: at most two cache
+//lines of metadata and, almost always, one slot. inserts that find both
+//buckets full move elements to their other bucket along the shortest path
+//found by a breadth-first search.
+//
+//the template parameters are those of hot_set minus the tombstone: occupancy
+//is kept in the fingerprints, so any value can be stored. Load selects buckets
+//and decides when to grow, counting in slots (4 per bucket)
+template<
+	class T,	//contained type
+	class Equal = std::equal_to<void>,//element comparator
+	class Alloc = std::allocator<T>, //allocator
+	class Hash = std::hash<T>,	//hasher
+	class Load = cuckoo_load_policy,//growth and bucket selection, see default_load_policy
+	class Instr = no_instrumentation//counts rehashes and probe steps, see instrumentation.h
+>
+class cuckoo_set
+{
+public:
+	typedef T value_type;
+	typedef Hash hasher;
+	typedef Equal key_equal;
+	typedef Load load_policy_type;
+	typedef Alloc allocator_type;
+	typedef Instr instrumentation_type;
+
+	enum : size_t { bucket_slots = 4 };
+
+private:
+	//fingerprint of the element in each slot, 0 if the slot is free
+	struct bucket
+	{
+		uint8_t fp[bucket_slots];
+	};
+
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<bucket> bucket_allocator;
+
+	//the two candidate buckets of an element and its fingerprint
+	struct location
+	{
+		bucket* b[2];
+		uint8_t fp;
+	};
+
+	//longest chain of displacements an insert tries before growing the table
+	enum : size_t { max_path = 5, max_nodes = 512 };
+
+	bucket* mbuckets;
+	bucket* mbuckets_end;
+	T* mslots;
+	size_t mcapacity;
+	size_t moccupied;
+	Hash hash;
+	Load load_alg;
+	Equal eq;
+	Alloc allocator;
+	Instr instr;
+
+	size_t bucket_count() const
+	{
+		return mbuckets_end - mbuckets;
+	}
+
+	T* slot(const bucket* b_, size_t i_) const
+	{
+		return mslots + (b_ - mbuckets) * bucket_slots + i_;
+	}
+
+	location locate(const T& value_) const
+	{
+		//the two bucket choices and the fingerprint come from different bits
+		//of the mixed hash, so identity hashes work too
+		auto m = hashing::fmix64(uint64_t(hash(value_)));
+		location l;
+		l.b[0] = load_alg.select(mbuckets, mbuckets_end, size_t(m));
+		l.b[1] = load_alg.select(mbuckets, mbuckets_end, size_t((m >> 32) | (m << 32)));
+		if (l.b[1] == l.b[0])
+		{
+			l.b[1] = mbuckets + ((l.b[0] - mbuckets) ^ 1);
+		}
+		l.fp = uint8_t(m >> 24);
+		l.fp += uint8_t(l.fp == 0);
+		return l;
+	}
+
+	//the bucket of value_ other than b_
+	bucket* alternate(const bucket* b_, const T& value_) const
+	{
+		auto l = locate(value_);
+		return l.b[0] == b_ ? l.b[1] : l.b[0];
+	}
+
+	//bit i set if slot i of b0_ (bits 0-3) or of b1_ (bits 4-7) has fingerprint fp_
+	static unsigned match(const bucket& b0_, const bucket& b1_, uint8_t fp_)
+	{
+#ifdef __SSE2__
+		uint32_t w0, w1;
+		std::memcpy(&w0, b0_.fp, sizeof(w0));
+		std::memcpy(&w1, b1_.fp, sizeof(w1));
+		auto v = _mm_cvtsi32_si128(int(w0));
+		v = _mm_unpacklo_epi32(v, _mm_cvtsi32_si128(int(w1)));
+		return unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(char(fp_))))) & 0xffu;
+#else
+		unsigned bits = 0;
+		for (size_t i = 0; i < bucket_slots; ++i)
+		{
+			bits |= unsigned(b0_.fp[i] == fp_) << i;
+			bits |= unsigned(b1_.fp[i] == fp_) << (i + bucket_slots);
+		}
+		return bits;
+#endif
+	}
+
+	static int free_slot(const bucket& b_)
+	{
+		unsigned bits = match(b_, b_, 0) & 0xfu;
+		return bits ? __builtin_ctz(bits) : -1;
+	}
+
+	T* find_slot(const T& value_) const
+	{
+		if (mbuckets == mbuckets_end)
+		{
+			return nullptr;
+		}
+		auto l = locate(value_);
+		unsigned bits = match(*l.b[0], *l.b[1], l.fp);
+		size_t steps = 0;
+		while (bits)
+		{
+			unsigned i = __builtin_ctz(bits);
+			bits &= bits - 1;
+			++steps;
+			auto s = slot(l.b[i / bucket_slots], i % bucket_slots);
+			if (eq(value_, *s))
+			{
+				instr.probe_steps(steps);
+				return s;
+			}
+		}
+		instr.probe_steps(steps);
+		return nullptr;
+	}
+
+	void init(size_t slots_)
+	{
+		if (slots_ > 0)
+		{
+			bucket_allocator ba(allocator);
+			auto n = slots_ / bucket_slots;
+			mbuckets = ba.allocate(n);
+			mbuckets_end = mbuckets + n;
+			std::memset(static_cast<void*>(mbuckets), 0, n * sizeof(bucket));
+			try
+			{
+				mslots = allocator.allocate(slots_);
+			}
+			catch (...)
+			{
+				ba.deallocate(mbuckets, n);
+				mbuckets = mbuckets_end = nullptr;
+				throw;
+			}
+			mcapacity = load_alg.occupancy(slots_);
+		}
+	}
+
+	void release()
+	{
+		if (mbuckets == mbuckets_end)
+		{
+			return;
+		}
+		for (auto b = mbuckets; b != mbuckets_end; ++b)
+		{
+			for (size_t i = 0; i < bucket_slots; ++i)
+			{
+				if (b->fp[i])
+				{
+					slot(b, i)->~T();
+				}
+			}
+		}
+		bucket_allocator ba(allocator);
+		allocator.deallocate(mslots, allocated());
+		ba.deallocate(mbuckets, bucket_count());
+		mbuckets = mbuckets_end = nullptr;
+		mslots = nullptr;
+		mcapacity = moccupied = 0;
+	}
+
+	void reallocate(size_t newslots_)
+	{
+		typename Instr::scope timer(instr, instr_event::rehash);
+		cuckoo_set other(hash, eq, load_alg, allocator);
+		other.init(newslots_);
+		for (auto b = mbuckets; b != mbuckets_end; ++b)
+		{
+			for (size_t i = 0; i < bucket_slots; ++i)
+			{
+				if (b->fp[i])
+				{
+					other.insert_unique(std::move(*slot(b, i)));
+				}
+			}
+		}
+		swap(other);
+	}
+
+	//breadth-first search from both candidate buckets for the closest free
+	//slot, then every element on the path moves one step towards it, which
+	//frees a slot in one of the candidates. returns that slot or nullptr if no
+	//free slot is within max_path displacements
+	T* make_room(const location& l_)
+	{
+		struct node
+		{
+			bucket* b;
+			int parent;			//index in nodes, -1 for the two roots
+			uint8_t from_slot;	//slot of the parent bucket whose element has b as other bucket
+			uint8_t depth;
+		};
+		node nodes[max_nodes];
+		size_t count = 0;
+		nodes[count++] = { l_.b[0], -1, 0, 0 };
+		nodes[count++] = { l_.b[1], -1, 0, 0 };
+
+		for (size_t head = 0; head < count; ++head)
+		{
+			auto n = nodes[head];
+			for (size_t s = 0; s < bucket_slots; ++s)
+			{
+				auto alt = alternate(n.b, *slot(n.b, s));
+				int free = free_slot(*alt);
+				if (free >= 0)
+				{
+					//shift along the path, from the free slot back to a root
+					auto free_b = alt;
+					size_t free_s = size_t(free);
+					auto from_b = n.b;
+					size_t from_s = s;
+					int at = int(head);
+					for (;;)
+					{
+						auto src = slot(from_b, from_s);
+						::new (static_cast<void*>(slot(free_b, free_s))) T(std::move(*src));
+						src->~T();
+						free_b->fp[free_s] = from_b->fp[from_s];
+						from_b->fp[from_s] = 0;
+						free_b = from_b;
+						free_s = from_s;
+						if (nodes[at].parent < 0)
+						{
+							break;
+						}
+						from_s = nodes[at].from_slot;
+						at = nodes[at].parent;
+						from_b = nodes[at].b;
+					}
+					return slot(free_b, free_s);
+				}
+
+				//a bucket may appear only once on a path, so that every element
+				//moved is still the one the search looked at
+				bool on_path = false;
+				for (int at = int(head); at >= 0 && !on_path; at = nodes[at].parent)
+				{
+					on_path = nodes[at].b == alt;
+				}
+				if (!on_path && n.depth + 1u < max_path && count < max_nodes)
+				{
+					nodes[count++] = { alt, int(head), uint8_t(s), uint8_t(n.depth + 1) };
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	//true if both candidate buckets are taken by elements hashing like value_:
+	//they share its buckets at every table size, so growing cannot make room
+	bool buckets_exhausted(const location& l_, const T& value_) const
+	{
+		auto h = hash(value_);
+		for (auto b : l_.b)
+		{
+			for (size_t i = 0; i < bucket_slots; ++i)
+			{
+				if (!b->fp[i] || hash(*slot(b, i)) != h)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	//precondition: value_ is not in the set
+	template<class U>
+	T* insert_unique(U&& value_)
+	{
+		if (moccupied == mcapacity)
+		{
+			reallocate(load_alg.grow(allocated()));
+		}
+		for (;;)
+		{
+			auto l = locate(value_);
+			T* s = nullptr;
+			unsigned empty = match(*l.b[0], *l.b[1], 0);
+			if (empty)
+			{
+				unsigned i = __builtin_ctz(empty);
+				s = slot(l.b[i / bucket_slots], i % bucket_slots);
+			}
+			else
+			{
+				s = make_room(l);
+			}
+			if (s)
+			{
+				::new (static_cast<void*>(s)) T(std::forward<U>(value_));
+				mbuckets[(s - mslots) / bucket_slots].fp[(s - mslots) % bucket_slots] = l.fp;
+				++moccupied;
+				return s;
+			}
+			if (buckets_exhausted(l, value_))
+			{
+				throw std::length_error("cuckoo_set: more than 8 keys with the same hash");
+			}
+			reallocate(load_alg.grow(allocated()));
+		}
+	}
+
+	cuckoo_set(const Hash& hash_, const Equal& equal_, const Load& load_, const Alloc& alloc_)
+		: mbuckets(nullptr)
+		, mbuckets_end(nullptr)
+		, mslots(nullptr)
+		, mcapacity(0)
+		, moccupied(0)
+		, hash(hash_)
+		, load_alg(load_)
+		, eq(equal_)
+		, allocator(alloc_)
+	{}
+
+public:
+	struct iterator
+	{
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		const cuckoo_set* set;
+		size_t index;
+
+		iterator(const cuckoo_set* set_, size_t index_)
+			: set(set_)
+			, index(index_)
+		{
+			advance();
+		}
+
+		void advance()
+		{
+			auto n = set->allocated();
+			while (index != n && set->mbuckets[index / bucket_slots].fp[index % bucket_slots] == 0)
+			{
+				++index;
+			}
+		}
+
+		const T& operator*() const
+		{
+			return set->mslots[index];
+		}
+
+		const T* operator->() const
+		{
+			return set->mslots + index;
+		}
+
+		iterator& operator++()
+		{
+			++index;
+			advance();
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator r(*this);
+			++*this;
+			return r;
+		}
+
+		bool operator==(const iterator& other) const
+		{
+			return index == other.index;
+		}
+
+		bool operator!=(const iterator& other) const
+		{
+			return index != other.index;
+		}
+	};
+
+	cuckoo_set()
+		: cuckoo_set(Hash(), Equal(), Load(), Alloc())
+	{}
+
+	explicit cuckoo_set(size_t capacity_, Hash hash_ = Hash(), Equal equal_ = Equal(), Load load_ = Load(), Alloc alloc_ = Alloc())
+		: cuckoo_set(hash_, equal_, load_, alloc_)
+	{
+		init(load_alg.allocated(capacity_));
+	}
+
+	cuckoo_set(const cuckoo_set& in)
+		: cuckoo_set(in.hash, in.eq, in.load_alg, in.allocator)
+	{
+		init(in.allocated());
+		for (auto b = in.mbuckets; b != in.mbuckets_end; ++b)
+		{
+			for (size_t i = 0; i < bucket_slots; ++i)
+			{
+				if (b->fp[i])
+				{
+					auto target = mbuckets + (b - in.mbuckets);
+					::new (static_cast<void*>(slot(target, i))) T(*in.slot(b, i));
+					target->fp[i] = b->fp[i];
+					++moccupied;
+				}
+			}
+		}
+	}
+
+	cuckoo_set(cuckoo_set&& in)
+		: cuckoo_set(in.hash, in.eq, in.load_alg, in.allocator)
+	{
+		swap(in);
+	}
+
+	cuckoo_set& operator=(cuckoo_set other_)
+	{
+		swap(other_);
+		return *this;
+	}
+
+	~cuckoo_set()
+	{
+		release();
+	}
+
+	void swap(cuckoo_set& other_)
+	{
+		using std::swap;
+		swap(mbuckets, other_.mbuckets);
+		swap(mbuckets_end, other_.mbuckets_end);
+		swap(mslots, other_.mslots);
+		swap(mcapacity, other_.mcapacity);
+		swap(moccupied, other_.moccupied);
+		swap(hash, other_.hash);
+		swap(load_alg, other_.load_alg);
+		swap(eq, other_.eq);
+		swap(allocator, other_.allocator);
+	}
+
+	//number of slots allocated by the set
+	size_t allocated() const
+	{
+		return bucket_count() * bucket_slots;
+	}
+
+	//number of elements the set may contain before reallocating
+	size_t capacity() const
+	{
+		return mcapacity;
+	}
+
+	size_t size() const
+	{
+		return moccupied;
+	}
+
+	bool empty() const
+	{
+		return moccupied == 0;
+	}
+
+	const Instr& instrumentation() const
+	{
+		return instr;
+	}
+
+	//makes room for count_ elements; an insert may still grow the table if the
+	//eviction search fails, which at this load is very unlikely
+	//invalidates all iterators if the set has to grow
+	void reserve(size_t count_)
+	{
+		if (count_ > mcapacity)
+		{
+			reallocate(load_alg.allocated(count_));
+		}
+	}
+
+	//returns the element and true if it was inserted, false if it was present
+	//invalidates all iterators. throws std::length_error for a 9th key with
+	//the same hash, which no table size can place
+	template<class U>
+	std::pair<const T*, bool> insert(U&& value_)
+	{
+		if (auto s = find_slot(value_))
+		{
+			return { s, false };
+		}
+		return { insert_unique(std::forward<U>(value_)), true };
+	}
+
+	//invalidates iterators to the element
+	bool erase(const T& value_)
+	{
+		auto s = find_slot(value_);
+		if (!s)
+		{
+			return false;
+		}
+		s->~T();
+		mbuckets[(s - mslots) / bucket_slots].fp[(s - mslots) % bucket_slots] = 0;
+		--moccupied;
+		return true;
+	}
+
+	void clear()
+	{
+		auto slots = allocated();
+		release();
+		init(slots);
+	}
+
+	//the element equal to value_, nullptr if there is none
+	const T* find(const T& value_) const
+	{
+		return find_slot(value_);
+	}
+
+	bool contains(const T& value_) const
+	{
+		return find_slot(value_) != nullptr;
+	}
+
+	size_t count(const T& value_) const
+	{
+		return contains(value_);
+	}
+
+	iterator begin() const
+	{
+		return iterator(this, 0);
+	}
+
+	iterator end() const
+	{
+		return iterator(this, allocated());
+	}
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "bloom_filter.h"
+#include "container_ops.h"
+#include "hash_functions.h"
+
+//any set of this repo or of benchmark.cpp behind a filter (bloom_filter.h) that
+//answers most misses without touching the set: a miss in hot_set probes up to
+//the next empty slot, one in stx::btree descends every level, while the filter
+//costs one cache line and, at 12 bits per key, fits in L2 or L3 long after the
+//set itself has left them
+//
+//the filter is sized for the expected number of keys and rebuilt from the set,
+//twice as large, when the set outgrows it; rebuilding iterates the set, so
+//Inner must be iterable over its keys. with blocked_bloom_filter erased keys
+//stay in the filter until the next rebuild and only cost false positives, with
+//counting_bloom_filter they are removed from it right away
+template<class Inner, class Filter = blocked_bloom_filter, class Hash = hashing::wy_hash>
+class filtered_set
+{
+public:
+	typedef container_ops::key_type_t<Inner> key_type;
+	typedef Inner inner_type;
+	typedef Filter filter_type;
+	typedef Hash hasher;
+
+private:
+	Inner mset;
+	Filter mfilter;
+	size_t mfilter_keys;	//number of keys the filter is sized for
+	Hash mhash;
+
+	template<class K>
+	uint64_t hash_of(const K& key_) const
+	{
+		return hashing::fmix64(uint64_t(mhash(key_)));
+	}
+
+	template<class C, class = void>
+	struct has_reserve : std::false_type
+	{};
+
+	template<class C>
+	struct has_reserve<C, std::void_t<decltype(std::declval<C&>().reserve(size_t()))>> : std::true_type
+	{};
+
+public:
+	explicit filtered_set(size_t expected_ = 1024, Inner inner_ = Inner(), Hash hash_ = Hash())
+		: mset(std::move(inner_))
+		, mfilter(expected_)
+		, mfilter_keys(expected_ > 0 ? expected_ : 1)
+		, mhash(std::move(hash_))
+	{
+		for (const auto& k : mset)
+			mfilter.insert(hash_of(k));
+	}
+
+	//true if key_ was not in the set
+	template<class K>
+	bool insert(K&& key_)
+	{
+		auto h = hash_of(key_);
+		if (!container_ops::insert(mset, std::forward<K>(key_)))
+			return false;
+		if (mset.size() > mfilter_keys)
+			rebuild_filter(2 * mset.size());
+		else
+			mfilter.insert(h);
+		return true;
+	}
+
+	//true if key_ was in the set
+	bool erase(const key_type& key_)
+	{
+		auto h = hash_of(key_);
+		if (!mfilter.may_contain(h) || !container_ops::erase(mset, key_))
+			return false;
+		if constexpr (Filter::supports_erase)
+			mfilter.erase(h);
+		return true;
+	}
+
+	template<class K>
+	bool contains(const K& key_) const
+	{
+		return mfilter.may_contain(hash_of(key_)) && container_ops::contains(mset, key_);
+	}
+
+	template<class K>
+	size_t count(const K& key_) const
+	{
+		return contains(key_);
+	}
+
+	size_t size() const
+	{
+		return mset.size();
+	}
+
+	bool empty() const
+	{
+		return mset.size() == 0;
+	}
+
+	//sizes the filter, and the set if it can reserve, for count_ keys
+	void reserve(size_t count_)
+	{
+		if constexpr (has_reserve<Inner>::value)
+			mset.reserve(count_);
+		if (count_ > mfilter_keys)
+			rebuild_filter(count_);
+	}
+
+	//replaces the filter by one sized for expected_ keys, holding those of the
+	//set; also drops the keys erased from a blocked_bloom_filter
+	void rebuild_filter(size_t expected_)
+	{
+		mfilter_keys = std::max<size_t>({ expected_, mset.size(), 1 });
+		Filter filter(mfilter_keys);
+		for (const auto& k : mset)
+			filter.insert(hash_of(k));
+		mfilter = std::move(filter);
+	}
+
+	const Inner& inner() const
+	{
+		return mset;
+	}
+
+	const Filter& filter() const
+	{
+		return mfilter;
+	}
+
+	auto begin() const
+	{
+		return mset.begin();
+	}
+
+	auto end() const
+	{
+		return mset.end();
+	}
+};
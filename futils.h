@@ -2,24 +2,204 @@
 
 #include <fstream>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <algorithm>
+#include <system_error>
+#include <cstring>
+#include <thread>
+#include <exception>
+#include <functional>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace io
 {
 
 std::string read_all(const std::string& filename)
 {
-	enum { BufferSize = 1024 };
-	char buff[BufferSize];
-
 	std::string str;
-	std::ifstream ifs(filename);
-	while (std::streamsize bytes = ifs.readsome(buff, BufferSize))
-		str.append(buff, bytes);
+	std::ifstream ifs(filename, std::ios::binary);
+	if (!ifs.seekg(0, std::ios::end))
+		return str;
+
+	str.resize(static_cast<size_t>(ifs.tellg()));
+	ifs.seekg(0, std::ios::beg);
+	ifs.read(&str[0], str.size());
+	str.resize(static_cast<size_t>(ifs.gcount()));
 
 	return str;
 }
 
+//returns the first '\n' in [first, last), or last
+inline const char* find_newline(const char* first, const char* last)
+{
+#ifdef __AVX2__
+	const __m256i nl = _mm256_set1_epi8('\n');
+	for (; last - first >= 32; first += 32)
+	{
+		__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+		unsigned mask = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl)));
+		if (mask)
+			return first + __builtin_ctz(mask);
+	}
+#endif
+	auto p = static_cast<const char*>(std::memchr(first, '\n', last - first));
+	return p ? p : last;
+}
+
+//calls f with a view of every line in buffer, without the trailing '\n'
+//an unterminated last line is reported too; views point into buffer
+template <typename F>
+void for_each_line_view(std::string_view buffer, F&& f)
+{
+	const char* bol = buffer.data();
+	const char* end = bol + buffer.size();
+
+	while (bol != end)
+	{
+		const char* eol = find_newline(bol, end);
+		f(std::string_view(bol, eol - bol));
+		if (eol == end)
+			break;
+		bol = eol + 1;
+	}
+}
+
+//splits buffer into at most nchunks pieces of roughly equal size, each ending
+//right after a '\n' (or at the end of the buffer), so no line straddles two pieces
+inline std::vector<std::string_view> split_at_lines(std::string_view buffer, size_t nchunks)
+{
+	std::vector<std::string_view> chunks;
+	nchunks = std::max<size_t>(nchunks, 1);
+
+	const char* first = buffer.data();
+	const char* end = first + buffer.size();
+	size_t target = buffer.size() / nchunks;
+
+	while (first != end)
+	{
+		const char* last = end;
+		if (chunks.size() + 1 < nchunks && size_t(end - first) > target)
+		{
+			last = find_newline(first + target, end);
+			if (last != end)
+				++last;
+		}
+		chunks.emplace_back(first, last - first);
+		first = last;
+	}
+	return chunks;
+}
+
+//runs f(i) for every i in [0, count) on its own thread and joins them
+//the first exception thrown by any of them is rethrown once all have finished;
+//std::system_error if a thread cannot be created, after joining those started
+template <typename F>
+void parallel_for_each_index(size_t count, F&& f)
+{
+	std::vector<std::thread> threads;
+	std::vector<std::exception_ptr> errors(count);
+	threads.reserve(count);
+
+	try
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			threads.emplace_back([&f, &errors, i]()
+			{
+				try
+				{
+					f(i);
+				}
+				catch (...)
+				{
+					errors[i] = std::current_exception();
+				}
+			});
+		}
+	}
+	catch (...)
+	{
+		//a thread could not be started: the running ones still use f and errors,
+		//and destroying them unjoined would terminate
+		for (auto& t : threads)
+			t.join();
+		throw;
+	}
+
+	for (auto& t : threads)
+		t.join();
+	for (auto& e : errors)
+		if (e)
+			std::rethrow_exception(e);
+}
+
+//parallel for_each_line_view: the buffer is cut into nthreads pieces on line
+//boundaries and f(thread_index, line) is called concurrently from each piece,
+//lines of one piece in order
+template <typename F>
+void parallel_for_each_line(std::string_view buffer, size_t nthreads, F&& f)
+{
+	auto chunks = split_at_lines(buffer, nthreads);
+	parallel_for_each_index(chunks.size(), [&](size_t i)
+	{
+		for_each_line_view(chunks[i], [&f, i](std::string_view line)
+		{
+			f(i, line);
+		});
+	});
+}
+
+//distributes the lines of buffer over npartitions by hash, using nthreads threads
+//for splitting and hashing; each partition can then be loaded into its own set
+//without synchronisation. empty lines are dropped, views point into buffer
+template <typename Hash = std::hash<std::string_view>>
+std::vector<std::vector<std::string_view>> parallel_partition_lines(std::string_view buffer, size_t nthreads, size_t npartitions, Hash hash = Hash())
+{
+	npartitions = std::max<size_t>(npartitions, 1);
+	auto chunks = split_at_lines(buffer, nthreads);
+
+	//staging[chunk][partition], filled without sharing
+	std::vector<std::vector<std::vector<std::string_view>>> staging(chunks.size());
+	parallel_for_each_index(chunks.size(), [&](size_t i)
+	{
+		auto& local = staging[i];
+		local.resize(npartitions);
+		for_each_line_view(chunks[i], [&](std::string_view line)
+		{
+			if (!line.empty())
+				local[hash(line) % npartitions].push_back(line);
+		});
+	});
+
+	//concatenate staging areas, partitions striped over the same number of threads
+	std::vector<std::vector<std::string_view>> partitions(npartitions);
+	size_t nworkers = std::min(npartitions, std::max<size_t>(chunks.size(), 1));
+	parallel_for_each_index(nworkers, [&](size_t w)
+	{
+		for (size_t p = w; p < npartitions; p += nworkers)
+		{
+			size_t total = 0;
+			for (auto& local : staging)
+				total += local[p].size();
+
+			auto& out = partitions[p];
+			out.reserve(total);
+			for (auto& local : staging)
+				out.insert(out.end(), local[p].begin(), local[p].end());
+		}
+	});
+	return partitions;
+}
+
 template <typename F>
 void for_each_line(const std::string& str, F&& f)
 {
@@ -33,5 +213,153 @@ void for_each_line(const std::string& str, F&& f)
     }
 };
 
+//read-only private mapping of a whole file, unmapped on destruction
+//throws std::system_error if the file cannot be opened or mapped
+class mapped_file
+{
+	const char* mdata;
+	size_t msize;
+
+public:
+	mapped_file()
+		: mdata(nullptr)
+		, msize(0)
+	{}
+
+	explicit mapped_file(const std::string& filename)
+		: mdata(nullptr)
+		, msize(0)
+	{
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::system_error(errno, std::generic_category(), "open " + filename);
+
+		struct stat st;
+		if (::fstat(fd, &st) < 0)
+		{
+			int err = errno;
+			::close(fd);
+			throw std::system_error(err, std::generic_category(), "fstat " + filename);
+		}
+
+		msize = st.st_size;
+		if (msize > 0)
+		{
+			void* p = ::mmap(nullptr, msize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED)
+			{
+				int err = errno;
+				::close(fd);
+				throw std::system_error(err, std::generic_category(), "mmap " + filename);
+			}
+			mdata = static_cast<const char*>(p);
+		}
+		::close(fd);
+	}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	mapped_file(mapped_file&& in)
+		: mdata(in.mdata)
+		, msize(in.msize)
+	{
+		in.mdata = nullptr;
+		in.msize = 0;
+	}
+
+	mapped_file& operator=(mapped_file&& in)
+	{
+		std::swap(mdata, in.mdata);
+		std::swap(msize, in.msize);
+		return *this;
+	}
+
+	~mapped_file()
+	{
+		if (mdata)
+			::munmap(const_cast<char*>(mdata), msize);
+	}
+
+	//hint the kernel about the expected access pattern, e.g. MADV_SEQUENTIAL
+	void advise(int advice) const
+	{
+		if (mdata)
+			::madvise(const_cast<char*>(mdata), msize, advice);
+	}
+
+	const char* data() const { return mdata; }
+	size_t size() const { return msize; }
+	const char* begin() const { return mdata; }
+	const char* end() const { return mdata + msize; }
+	std::string_view view() const { return std::string_view(mdata, msize); }
+};
+
+//zero-copy line iteration over a whole file
+//the views passed to f are only valid until this function returns
+template <typename F>
+void for_each_mapped_line(const std::string& filename, F&& f)
+{
+	mapped_file file(filename);
+	file.advise(MADV_SEQUENTIAL);
+	for_each_line_view(file.view(), std::forward<F>(f));
+}
+
+//streams filename through a buffer of chunk_size bytes, for files that should not
+//be mapped as a whole; a line crossing a chunk boundary is carried into the next
+//read and the buffer grows if a single line does not fit
+//the views passed to f are only valid for the duration of the call
+template <typename F>
+void for_each_line_chunked(const std::string& filename, F&& f, size_t chunk_size = size_t(64) << 20)
+{
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), "open " + filename);
+	::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	std::vector<char> buffer(std::max<size_t>(chunk_size, 1));
+	size_t pending = 0;
+
+	try
+	{
+		for (;;)
+		{
+			if (pending == buffer.size())
+				buffer.resize(buffer.size() * 2);
+
+			ssize_t bytes = ::read(fd, buffer.data() + pending, buffer.size() - pending);
+			if (bytes < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				throw std::system_error(errno, std::generic_category(), "read " + filename);
+			}
+			if (bytes == 0)
+				break;
+
+			const char* first = buffer.data();
+			const char* last = first + pending + bytes;
+			const char* bol = first;
+			for (const char* eol = find_newline(bol, last); eol != last; eol = find_newline(bol, last))
+			{
+				f(std::string_view(bol, eol - bol));
+				bol = eol + 1;
+			}
+
+			pending = last - bol;
+			std::memmove(buffer.data(), bol, pending);
+		}
+	}
+	catch (...)
+	{
+		::close(fd);
+		throw;
+	}
+	::close(fd);
+
+	if (pending > 0)
+		f(std::string_view(buffer.data(), pending));
+}
+
 }
 
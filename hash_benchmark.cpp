@@ -0,0 +1,171 @@
+#include "futils.h"
+#include "hash_functions.h"
+#include "hot_set.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <x86intrin.h>
+
+// std::hash as the baseline: Murmur-based for strings, identity for integers
+struct std_hash
+{
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>()(s); }
+    size_t operator()(uint64_t v) const { return std::hash<uint64_t>()(v); }
+};
+
+template <typename H>
+void bench_string_speed(const char* name, const std::vector<char>& buffer)
+{
+    H h;
+    std::printf("%-10s", name);
+    for (size_t len : {4, 8, 16, 32, 64, 256, 1024})
+    {
+        const size_t iterations = (size_t(64) << 20) / len;
+        uint64_t acc = 0;
+        auto start = __rdtsc();
+        for (size_t i = 0; i < iterations; ++i)
+            acc += h(std::string_view(buffer.data() + (i & 1023), len));
+        auto cycles = __rdtsc() - start;
+        asm volatile("" : : "r"(acc));
+        std::printf("%10.2f", double(len * iterations) / cycles);
+    }
+    std::printf("\n");
+}
+
+template <typename H>
+void bench_int_speed(const char* name)
+{
+    H h;
+    const size_t iterations = size_t(1) << 26;
+    uint64_t acc = 0;
+    auto start = __rdtsc();
+    for (uint64_t i = 0; i < iterations; ++i)
+        acc += h(i * 0x10001);
+    auto cycles = __rdtsc() - start;
+    asm volatile("" : : "r"(acc));
+    std::printf("%-10s%10.2f\n", name, double(cycles) / iterations);
+}
+
+// observed colliding pairs divided by the number expected from a uniform hash:
+// ~1 is ideal, large values mean clustering
+double collision_ratio(const std::vector<size_t>& buckets, size_t n)
+{
+    double pairs = 0;
+    for (auto b : buckets)
+        pairs += double(b) * (b - 1) / 2;
+    double expected = double(n) * (n - 1) / (2.0 * buckets.size());
+    return expected > 0 ? pairs / expected : 0;
+}
+
+struct quality
+{
+    double mask_ratio;     // hot_set: Load::select
+    size_t mask_max;
+    double chained_ratio;  // ht_chained: hash % bucket_count
+    size_t chained_max;    // above 8 ht_chained would keep expanding
+    double lookup_ns;      // hot_set successful lookup
+};
+
+template <typename H, typename Load, typename K>
+quality measure(const std::vector<K>& keys)
+{
+    quality q = {};
+    H h;
+
+    Load load;
+    std::vector<size_t> mask_buckets(load.allocated(keys.size()));
+    for (const auto& k : keys)
+        ++*load.select(mask_buckets.data(), mask_buckets.data() + mask_buckets.size(), h(k));
+    q.mask_ratio = collision_ratio(mask_buckets, keys.size());
+    q.mask_max = *std::max_element(mask_buckets.begin(), mask_buckets.end());
+
+    // simulated rather than built: with a bad hash ht_chained expands until it runs out of memory
+    size_t chained_count = 32;
+    while (chained_count < keys.size())
+        chained_count *= 2;
+    std::vector<size_t> chained_buckets(chained_count);
+    for (const auto& k : keys)
+        ++chained_buckets[h(k) % chained_count];
+    q.chained_ratio = collision_ratio(chained_buckets, keys.size());
+    q.chained_max = *std::max_element(chained_buckets.begin(), chained_buckets.end());
+
+    // K() is never a key: strided keys start at the stride, empty words are skipped
+    hot_set<K, variable<K>, std::equal_to<void>, std::allocator<K>, H, Load> set(0, variable<K>(K()));
+    for (const auto& k : keys)
+        set.insert(k);
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& k : keys)
+        found += set.contains(k);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    asm volatile("" : : "r"(found));
+    q.lookup_ns = std::chrono::duration<double, std::nano>(elapsed).count() / keys.size();
+
+    return q;
+}
+
+template <typename K>
+void report_quality(const char* keyset, const std::vector<K>& keys)
+{
+    auto print = [&](const char* name, const quality& q)
+    {
+        std::printf("%-22s %-10s %14.2f %10zu %14.2f %10zu %12.1f\n", keyset, name,
+                    q.mask_ratio, q.mask_max, q.chained_ratio, q.chained_max, q.lookup_ns);
+    };
+    print("std::hash", measure<std_hash, default_load_policy>(keys));
+    print("std+fib", measure<std_hash, fibonacci_load_policy>(keys));
+    print("wy", measure<hashing::wy_hash, default_load_policy>(keys));
+    print("mix", measure<hashing::mix_hash, default_load_policy>(keys));
+    print("crc", measure<hashing::crc_hash, default_load_policy>(keys));
+}
+
+std::vector<uint64_t> strided_keys(size_t n, uint64_t stride)
+{
+    std::vector<uint64_t> v(n);
+    for (size_t i = 0; i < n; ++i)
+        v[i] = (i + 1) * stride;
+    return v;
+}
+
+int main()
+{
+    std::vector<char> buffer(4096);
+    std::mt19937_64 rng(42);
+    for (auto& c : buffer)
+        c = char(rng());
+
+    std::printf("string hash throughput (bytes/cycle) by key length\n");
+    std::printf("%-10s%10s%10s%10s%10s%10s%10s%10s\n", "hash", "4", "8", "16", "32", "64", "256", "1024");
+    bench_string_speed<std_hash>("std::hash", buffer);
+    bench_string_speed<hashing::wy_hash>("wy", buffer);
+    bench_string_speed<hashing::crc_hash>("crc", buffer);
+
+    std::printf("\ninteger hash cost (cycles/hash)\n");
+    bench_int_speed<std_hash>("std::hash");
+    bench_int_speed<hashing::wy_hash>("wy");
+    bench_int_speed<hashing::mix_hash>("mix");
+    bench_int_speed<hashing::crc_hash>("crc");
+
+    std::printf("\nbucket distribution (collision ratio: 1 = uniform) and hot_set lookup cost\n");
+    std::printf("%-22s %-10s %14s %10s %14s %10s %12s\n", "keys", "hash", "hot_set ratio", "max", "chained ratio", "max", "lookup (ns)");
+
+    std::vector<std::string> words;
+    io::for_each_mapped_line("/etc/dictionaries-common/words", [&words](std::string_view w)
+    {
+        if (!w.empty())
+            words.emplace_back(w);
+    });
+    report_quality("dictionary words", words);
+
+    const size_t n = size_t(1) << 15;
+    report_quality("sequential", strided_keys(n, 1));
+    report_quality("stride 16 (pointers)", strided_keys(n, 16));
+    report_quality("stride 4096 (pages)", strided_keys(n, 4096));
+    report_quality("high 32 bits", strided_keys(n, uint64_t(1) << 32));
+
+    return 0;
+}
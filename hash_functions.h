@@ -0,0 +1,269 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+//hash functions usable as the Hash parameter of hot_set, ht_chained and the
+//third-party sets
+//
+//every functor hashes anything convertible to std::string_view (std::string,
+//string_view, inline_string) by its characters, and integers, enums and
+//pointers by their value. unlike std::hash, none of them is the identity on
+//integers, so keys that only differ in their high bits, such as aligned
+//pointers or strided ids, still spread over a power-of-two table.
+
+namespace hashing
+{
+
+//64-bit finaliser of MurmurHash3: multiply-xorshift, full avalanche
+inline uint64_t fmix64(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdull;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ull;
+	k ^= k >> 33;
+	return k;
+}
+
+//splitmix64 output function: same family as fmix64, different constants
+inline uint64_t splitmix64(uint64_t k)
+{
+	k += 0x9e3779b97f4a7c15ull;
+	k = (k ^ (k >> 30)) * 0xbf58476d1ce4e5b9ull;
+	k = (k ^ (k >> 27)) * 0x94d049bb133111ebull;
+	return k ^ (k >> 31);
+}
+
+namespace detail
+{
+
+static const uint64_t wyp[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+
+inline void wymum(uint64_t& a, uint64_t& b)
+{
+	__uint128_t r = a;
+	r *= b;
+	a = uint64_t(r);
+	b = uint64_t(r >> 64);
+}
+
+inline uint64_t wymix(uint64_t a, uint64_t b)
+{
+	wymum(a, b);
+	return a ^ b;
+}
+
+inline uint64_t read8(const uint8_t* p)
+{
+	uint64_t v;
+	std::memcpy(&v, p, 8);
+	return v;
+}
+
+inline uint64_t read4(const uint8_t* p)
+{
+	uint32_t v;
+	std::memcpy(&v, p, 4);
+	return v;
+}
+
+inline uint64_t read3(const uint8_t* p, size_t k)
+{
+	return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1];
+}
+
+//software CRC32C (Castagnoli), byte at a time
+struct crc32c_table
+{
+	uint32_t t[256];
+
+	crc32c_table()
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k)
+				c = (c >> 1) ^ (0x82f63b78u & (0u - (c & 1)));
+			t[i] = c;
+		}
+	}
+};
+
+inline uint32_t crc32c_u8(uint32_t crc, uint8_t v)
+{
+#ifdef __SSE4_2__
+	return _mm_crc32_u8(crc, v);
+#else
+	static const crc32c_table table;
+	return table.t[(crc ^ v) & 0xff] ^ (crc >> 8);
+#endif
+}
+
+inline uint32_t crc32c_u64(uint32_t crc, uint64_t v)
+{
+#ifdef __SSE4_2__
+	return uint32_t(_mm_crc32_u64(crc, v));
+#else
+	for (int i = 0; i < 8; ++i)
+		crc = crc32c_u8(crc, uint8_t(v >> (8 * i)));
+	return crc;
+#endif
+}
+
+template<class T>
+using if_integral = typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value, size_t>::type;
+
+template<class T>
+uint64_t to_u64(T value)
+{
+	uint64_t v = 0;
+	std::memcpy(&v, &value, sizeof(T) < 8 ? sizeof(T) : 8);
+	return v;
+}
+
+}
+
+//wyhash (final version 4), a multiply-mix string hash of the xxh3 class
+inline uint64_t wyhash(const void* key, size_t len, uint64_t seed = 0)
+{
+	using namespace detail;
+	auto p = static_cast<const uint8_t*>(key);
+	seed ^= wymix(seed ^ wyp[0], wyp[1]);
+	uint64_t a, b;
+	if (len <= 16)
+	{
+		if (len >= 4)
+		{
+			a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+			b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+		}
+		else if (len > 0)
+		{
+			a = read3(p, len);
+			b = 0;
+		}
+		else
+			a = b = 0;
+	}
+	else
+	{
+		size_t i = len;
+		if (i > 48)
+		{
+			uint64_t see1 = seed, see2 = seed;
+			do
+			{
+				seed = wymix(read8(p) ^ wyp[1], read8(p + 8) ^ seed);
+				see1 = wymix(read8(p + 16) ^ wyp[2], read8(p + 24) ^ see1);
+				see2 = wymix(read8(p + 32) ^ wyp[3], read8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16)
+		{
+			seed = wymix(read8(p) ^ wyp[1], read8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = read8(p + i - 16);
+		b = read8(p + i - 8);
+	}
+	a ^= wyp[1];
+	b ^= seed;
+	wymum(a, b);
+	return wymix(a ^ wyp[0] ^ len, b ^ wyp[1]);
+}
+
+//CRC32C over the key, 8 bytes per instruction with SSE4.2 (table driven
+//otherwise). two independent 32-bit lanes make up the 64-bit result
+inline uint64_t crc32c_hash(const void* key, size_t len, uint64_t seed = 0)
+{
+	using namespace detail;
+	auto p = static_cast<const uint8_t*>(key);
+	uint32_t lo = uint32_t(seed) ^ 0xffffffffu;
+	uint32_t hi = uint32_t(seed >> 32) ^ 0x9e3779b9u ^ uint32_t(len);
+	for (; len >= 8; len -= 8, p += 8)
+	{
+		auto v = read8(p);
+		lo = crc32c_u64(lo, v);
+		hi = crc32c_u64(hi, v ^ 0x5555555555555555ull);
+	}
+	for (; len > 0; --len, ++p)
+	{
+		lo = crc32c_u8(lo, *p);
+		hi = crc32c_u8(hi, uint8_t(*p ^ 0x55));
+	}
+	return (uint64_t(hi) << 32) | lo;
+}
+
+//wyhash for strings, one wymix round for integers
+struct wy_hash
+{
+	size_t operator()(std::string_view s) const
+	{
+		return wyhash(s.data(), s.size());
+	}
+
+	size_t operator()(const char* s) const
+	{
+		return wyhash(s, std::strlen(s));
+	}
+
+	template<class T>
+	detail::if_integral<T> operator()(T value) const
+	{
+		return detail::wymix(detail::to_u64(value) ^ detail::wyp[0], detail::wyp[1]);
+	}
+};
+
+//wyhash for strings, fmix64 for integers
+struct mix_hash
+{
+	size_t operator()(std::string_view s) const
+	{
+		return wyhash(s.data(), s.size());
+	}
+
+	size_t operator()(const char* s) const
+	{
+		return wyhash(s, std::strlen(s));
+	}
+
+	template<class T>
+	detail::if_integral<T> operator()(T value) const
+	{
+		return fmix64(detail::to_u64(value));
+	}
+};
+
+//hardware CRC32C for strings and integers
+struct crc_hash
+{
+	size_t operator()(std::string_view s) const
+	{
+		return crc32c_hash(s.data(), s.size());
+	}
+
+	size_t operator()(const char* s) const
+	{
+		return crc32c_hash(s, std::strlen(s));
+	}
+
+	template<class T>
+	detail::if_integral<T> operator()(T value) const
+	{
+		auto v = detail::to_u64(value);
+		return (uint64_t(detail::crc32c_u64(0x9e3779b9u, v)) << 32) | detail::crc32c_u64(0xffffffffu, v);
+	}
+};
+
+}
@@ -0,0 +1,557 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "hash_functions.h"
+#include "hot_set.h"
+
+//with 32-slot neighbourhoods inserts rarely fail below 85% load; past that
+//an insert that finds no room grows the table early
+struct hopscotch_load_policy : default_load_policy
+{
+	size_t occupancy(size_t allocated)
+	{
+		return allocated - allocated / 10;
+	}
+
+	size_t allocated(size_t occupied)
+	{
+		if (occupied == 0)
+			return 0;
+		size_t n = 32;
+		while (occupancy(n) < occupied)
+			n <<= 1;
+		return n;
+	}
+};
+
+//hopscotch hashing: every element lives within neighbourhood_size slots of
+//its home bucket, and each bucket keeps a bitmap of which of those slots hold
+//its elements. a lookup reads one bitmap and compares only the flagged slots,
+//all within 32 slots of home, so it touches one or two cache lines of slots at
+//any load. an insert whose closest free slot is out of reach moves elements of
+//earlier buckets into it, within their own neighbourhoods, until the free slot
+//is close enough; if that fails the table grows.
+//
+//the last bucket's neighbourhood runs into a tail of neighbourhood_size - 1
+//extra slots instead of wrapping around. the template parameters are those of
+//cuckoo_set; Load selects the home bucket and decides when to grow
+template<
+	class T,	//contained type
+	class Equal = std::equal_to<void>,//element comparator
+	class Alloc = std::allocator<T>, //allocator
+	class Hash = std::hash<T>,	//hasher
+	class Load = hopscotch_load_policy,//growth and home bucket selection, see default_load_policy
+	class Instr = no_instrumentation//counts rehashes and probe steps, see instrumentation.h
+>
+class hopscotch_set
+{
+public:
+	typedef T value_type;
+	typedef Hash hasher;
+	typedef Equal key_equal;
+	typedef Load load_policy_type;
+	typedef Alloc allocator_type;
+	typedef Instr instrumentation_type;
+
+	enum : size_t { neighbourhood_size = 32 };
+
+private:
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<uint32_t> hop_allocator;
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<uint64_t> bitmap_allocator;
+
+	//bit i of mhops[b]: slot b + i holds an element whose home is bucket b
+	uint32_t* mhops;
+	uint32_t* mhops_end;
+	//bit i of word w: slot 64 * w + i holds an element
+	uint64_t* mfull;
+	T* mslots;
+	size_t mcapacity;
+	size_t moccupied;
+	Hash hash;
+	Load load_alg;
+	Equal eq;
+	Alloc allocator;
+	Instr instr;
+
+	size_t bucket_count() const
+	{
+		return mhops_end - mhops;
+	}
+
+	static size_t bitmap_words(size_t slots_)
+	{
+		return (slots_ + 63) / 64;
+	}
+
+	bool is_full(size_t slot_) const
+	{
+		return (mfull[slot_ / 64] >> (slot_ % 64)) & 1;
+	}
+
+	void set_full(size_t slot_, bool full_)
+	{
+		auto bit = uint64_t(1) << (slot_ % 64);
+		mfull[slot_ / 64] = full_ ? (mfull[slot_ / 64] | bit) : (mfull[slot_ / 64] & ~bit);
+	}
+
+	size_t home(const T& value_) const
+	{
+		auto m = hashing::fmix64(uint64_t(hash(value_)));
+		return load_alg.select(mhops, mhops_end, size_t(m)) - mhops;
+	}
+
+	//first free slot at or after from_, allocated() if there is none
+	size_t next_free(size_t from_) const
+	{
+		auto n = allocated();
+		for (auto w = from_ / 64; w < bitmap_words(n); ++w)
+		{
+			auto free = ~mfull[w];
+			if (w == from_ / 64)
+			{
+				free &= ~uint64_t(0) << (from_ % 64);
+			}
+			if (free)
+			{
+				auto s = w * 64 + __builtin_ctzll(free);
+				return s < n ? s : n;
+			}
+		}
+		return n;
+	}
+
+	T* find_slot(const T& value_) const
+	{
+		if (mhops == mhops_end)
+		{
+			return nullptr;
+		}
+		auto b = home(value_);
+		auto bits = mhops[b];
+		size_t steps = 0;
+		while (bits)
+		{
+			auto i = __builtin_ctz(bits);
+			bits &= bits - 1;
+			++steps;
+			auto s = mslots + b + i;
+			if (eq(value_, *s))
+			{
+				instr.probe_steps(steps);
+				return s;
+			}
+		}
+		instr.probe_steps(steps);
+		return nullptr;
+	}
+
+	void init(size_t buckets_)
+	{
+		if (buckets_ > 0)
+		{
+			hop_allocator ha(allocator);
+			bitmap_allocator ba(allocator);
+			auto slots = buckets_ + neighbourhood_size - 1;
+			mhops = ha.allocate(buckets_);
+			mhops_end = mhops + buckets_;
+			std::memset(mhops, 0, buckets_ * sizeof(uint32_t));
+			try
+			{
+				mfull = ba.allocate(bitmap_words(slots));
+				std::memset(mfull, 0, bitmap_words(slots) * sizeof(uint64_t));
+				try
+				{
+					mslots = allocator.allocate(slots);
+				}
+				catch (...)
+				{
+					ba.deallocate(mfull, bitmap_words(slots));
+					throw;
+				}
+			}
+			catch (...)
+			{
+				ha.deallocate(mhops, buckets_);
+				mhops = mhops_end = nullptr;
+				mfull = nullptr;
+				throw;
+			}
+			mcapacity = load_alg.occupancy(buckets_);
+		}
+	}
+
+	void release()
+	{
+		if (mhops == mhops_end)
+		{
+			return;
+		}
+		auto slots = allocated();
+		for (size_t s = 0; s < slots; ++s)
+		{
+			if (is_full(s))
+			{
+				mslots[s].~T();
+			}
+		}
+		hop_allocator ha(allocator);
+		bitmap_allocator ba(allocator);
+		allocator.deallocate(mslots, slots);
+		ba.deallocate(mfull, bitmap_words(slots));
+		ha.deallocate(mhops, bucket_count());
+		mhops = mhops_end = nullptr;
+		mfull = nullptr;
+		mslots = nullptr;
+		mcapacity = moccupied = 0;
+	}
+
+	void reallocate(size_t newbuckets_)
+	{
+		typename Instr::scope timer(instr, instr_event::rehash);
+		hopscotch_set other(hash, eq, load_alg, allocator);
+		other.init(newbuckets_);
+		auto slots = allocated();
+		for (size_t s = 0; s < slots; ++s)
+		{
+			if (is_full(s))
+			{
+				other.insert_unique(std::move(mslots[s]));
+			}
+		}
+		swap(other);
+	}
+
+	//moves an element of one of the neighbourhood_size - 1 buckets before free_
+	//into free_ and returns the slot it left, closer to the start of the table;
+	//returns free_ if no such element can move without leaving its neighbourhood
+	size_t hop_back(size_t free_)
+	{
+		auto last = std::min(free_, bucket_count());
+		for (size_t b = free_ - (neighbourhood_size - 1); b < last; ++b)
+		{
+			//the element of b closest to b is the farthest back it can go
+			auto bits = mhops[b];
+			if (bits == 0)
+			{
+				continue;
+			}
+			auto i = size_t(__builtin_ctz(bits));
+			if (b + i >= free_)
+			{
+				continue;
+			}
+			auto from = b + i;
+			::new (static_cast<void*>(mslots + free_)) T(std::move(mslots[from]));
+			mslots[from].~T();
+			set_full(free_, true);
+			set_full(from, false);
+			mhops[b] = (bits & ~(uint32_t(1) << i)) | (uint32_t(1) << (free_ - b));
+			return from;
+		}
+		return free_;
+	}
+
+	//true if the neighbourhood of b_ is taken by elements hashing like value_:
+	//they share a home bucket at every table size, so growing cannot make room
+	bool home_exhausted(size_t b_, const T& value_) const
+	{
+		if (mhops[b_] != ~uint32_t(0))
+		{
+			return false;
+		}
+		auto h = hash(value_);
+		for (size_t i = 0; i < neighbourhood_size; ++i)
+		{
+			if (hash(mslots[b_ + i]) != h)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//precondition: value_ is not in the set
+	template<class U>
+	T* insert_unique(U&& value_)
+	{
+		if (moccupied == mcapacity)
+		{
+			reallocate(load_alg.grow(bucket_count()));
+		}
+		for (;;)
+		{
+			auto b = home(value_);
+			auto free = next_free(b);
+			while (free < allocated() && free - b >= neighbourhood_size)
+			{
+				auto moved = hop_back(free);
+				if (moved == free)
+				{
+					free = allocated();
+				}
+				else
+				{
+					free = moved;
+				}
+			}
+			if (free < allocated())
+			{
+				::new (static_cast<void*>(mslots + free)) T(std::forward<U>(value_));
+				set_full(free, true);
+				mhops[b] |= uint32_t(1) << (free - b);
+				++moccupied;
+				return mslots + free;
+			}
+			if (home_exhausted(b, value_))
+			{
+				throw std::length_error("hopscotch_set: more than 32 keys with the same hash");
+			}
+			reallocate(load_alg.grow(bucket_count()));
+		}
+	}
+
+	hopscotch_set(const Hash& hash_, const Equal& equal_, const Load& load_, const Alloc& alloc_)
+		: mhops(nullptr)
+		, mhops_end(nullptr)
+		, mfull(nullptr)
+		, mslots(nullptr)
+		, mcapacity(0)
+		, moccupied(0)
+		, hash(hash_)
+		, load_alg(load_)
+		, eq(equal_)
+		, allocator(alloc_)
+	{}
+
+public:
+	struct iterator
+	{
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		const hopscotch_set* set;
+		size_t index;
+
+		iterator(const hopscotch_set* set_, size_t index_)
+			: set(set_)
+			, index(index_)
+		{
+			advance();
+		}
+
+		void advance()
+		{
+			auto n = set->allocated();
+			while (index != n && !set->is_full(index))
+			{
+				++index;
+			}
+		}
+
+		const T& operator*() const
+		{
+			return set->mslots[index];
+		}
+
+		const T* operator->() const
+		{
+			return set->mslots + index;
+		}
+
+		iterator& operator++()
+		{
+			++index;
+			advance();
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator r(*this);
+			++*this;
+			return r;
+		}
+
+		bool operator==(const iterator& other) const
+		{
+			return index == other.index;
+		}
+
+		bool operator!=(const iterator& other) const
+		{
+			return index != other.index;
+		}
+	};
+
+	hopscotch_set()
+		: hopscotch_set(Hash(), Equal(), Load(), Alloc())
+	{}
+
+	explicit hopscotch_set(size_t capacity_, Hash hash_ = Hash(), Equal equal_ = Equal(), Load load_ = Load(), Alloc alloc_ = Alloc())
+		: hopscotch_set(hash_, equal_, load_, alloc_)
+	{
+		init(load_alg.allocated(capacity_));
+	}
+
+	hopscotch_set(const hopscotch_set& in)
+		: hopscotch_set(in.hash, in.eq, in.load_alg, in.allocator)
+	{
+		init(in.bucket_count());
+		auto slots = allocated();
+		for (size_t s = 0; s < slots; ++s)
+		{
+			if (in.is_full(s))
+			{
+				::new (static_cast<void*>(mslots + s)) T(in.mslots[s]);
+				set_full(s, true);
+			}
+		}
+		if (slots > 0)
+		{
+			std::memcpy(mhops, in.mhops, bucket_count() * sizeof(uint32_t));
+		}
+		moccupied = in.moccupied;
+	}
+
+	hopscotch_set(hopscotch_set&& in)
+		: hopscotch_set(in.hash, in.eq, in.load_alg, in.allocator)
+	{
+		swap(in);
+	}
+
+	hopscotch_set& operator=(hopscotch_set other_)
+	{
+		swap(other_);
+		return *this;
+	}
+
+	~hopscotch_set()
+	{
+		release();
+	}
+
+	void swap(hopscotch_set& other_)
+	{
+		using std::swap;
+		swap(mhops, other_.mhops);
+		swap(mhops_end, other_.mhops_end);
+		swap(mfull, other_.mfull);
+		swap(mslots, other_.mslots);
+		swap(mcapacity, other_.mcapacity);
+		swap(moccupied, other_.moccupied);
+		swap(hash, other_.hash);
+		swap(load_alg, other_.load_alg);
+		swap(eq, other_.eq);
+		swap(allocator, other_.allocator);
+	}
+
+	//number of slots allocated by the set, tail included
+	size_t allocated() const
+	{
+		return bucket_count() == 0 ? 0 : bucket_count() + neighbourhood_size - 1;
+	}
+
+	//number of elements the set may contain before reallocating
+	size_t capacity() const
+	{
+		return mcapacity;
+	}
+
+	size_t size() const
+	{
+		return moccupied;
+	}
+
+	bool empty() const
+	{
+		return moccupied == 0;
+	}
+
+	const Instr& instrumentation() const
+	{
+		return instr;
+	}
+
+	//invalidates all iterators if the set has to grow
+	void reserve(size_t count_)
+	{
+		if (count_ > mcapacity)
+		{
+			reallocate(load_alg.allocated(count_));
+		}
+	}
+
+	//returns the element and true if it was inserted, false if it was present
+	//invalidates all iterators. throws std::length_error for a 33rd key with
+	//the same hash, which no table size can place
+	template<class U>
+	std::pair<const T*, bool> insert(U&& value_)
+	{
+		if (auto s = find_slot(value_))
+		{
+			return { s, false };
+		}
+		return { insert_unique(std::forward<U>(value_)), true };
+	}
+
+	//invalidates iterators to the element
+	bool erase(const T& value_)
+	{
+		auto s = find_slot(value_);
+		if (!s)
+		{
+			return false;
+		}
+		auto index = size_t(s - mslots);
+		auto b = home(value_);
+		s->~T();
+		set_full(index, false);
+		mhops[b] &= ~(uint32_t(1) << (index - b));
+		--moccupied;
+		return true;
+	}
+
+	void clear()
+	{
+		auto buckets = bucket_count();
+		release();
+		init(buckets);
+	}
+
+	//the element equal to value_, nullptr if there is none
+	const T* find(const T& value_) const
+	{
+		return find_slot(value_);
+	}
+
+	bool contains(const T& value_) const
+	{
+		return find_slot(value_) != nullptr;
+	}
+
+	size_t count(const T& value_) const
+	{
+		return contains(value_);
+	}
+
+	iterator begin() const
+	{
+		return iterator(this, 0);
+	}
+
+	iterator end() const
+	{
+		return iterator(this, allocated());
+	}
+};
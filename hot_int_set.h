@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "hash_functions.h"
+#include "hot_set.h"
+
+//hot_set for integral keys with 0 as the compile-time tombstone, so that its
+//probes take the is_integral_probe path, plus a flag for the key 0 itself,
+//which the table cannot hold. every key of T can be inserted.
+//
+//the default hasher is hashing::mix_hash: std::hash is the identity on integers
+//and default_load_policy keeps the low bits, so strided keys would share slots
+template<
+	class T,	//integral key type
+	class Hash = hashing::mix_hash,	//hasher
+	class Load = default_load_policy,//controls load factor and related concerns
+	class Alloc = std::allocator<T>, //allocator
+	class Instr = no_instrumentation//counts rehashes and probe steps, see instrumentation.h
+>
+class hot_int_set
+{
+	static_assert(std::is_integral<T>::value, "hot_int_set: T must be an integral type");
+
+public:
+	typedef T value_type;
+	typedef Hash hasher;
+	typedef Load load_policy_type;
+	typedef Alloc allocator_type;
+	typedef Instr instrumentation_type;
+	typedef hot_set<T, std::integral_constant<T, 0>, std::equal_to<T>, Alloc, Hash, Load, Instr> table_type;
+
+private:
+	table_type mtable;
+	bool mhas_zero;
+	//what find() and iterators point to for the key 0
+	T mzero;
+
+public:
+	//the keys of the table, then 0 if the set holds it
+	struct iterator
+	{
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		typename table_type::iterator current;
+		typename table_type::iterator table_end;
+		const T* zero;
+
+		iterator(typename table_type::iterator current_, typename table_type::iterator end_, const T* zero_)
+			: current(current_)
+			, table_end(end_)
+			, zero(zero_)
+		{}
+
+		const T& operator*() const
+		{
+			return current != table_end ? *current : *zero;
+		}
+
+		const T* operator->() const
+		{
+			return &**this;
+		}
+
+		iterator& operator++()
+		{
+			if (current != table_end)
+				++current;
+			else
+				zero = nullptr;
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator r(*this);
+			++*this;
+			return r;
+		}
+
+		bool operator==(const iterator& other) const
+		{
+			return current == other.current && zero == other.zero;
+		}
+
+		bool operator!=(const iterator& other) const
+		{
+			return !(*this == other);
+		}
+	};
+
+	hot_int_set()
+		: mtable(0)
+		, mhas_zero(false)
+		, mzero(0)
+	{}
+
+	explicit hot_int_set(size_t capacity_, Hash hash_ = Hash(), Load load_ = Load(), Alloc alloc_ = Alloc())
+		: mtable(capacity_, std::integral_constant<T, 0>(), std::move(hash_), std::equal_to<T>(), std::move(load_), std::move(alloc_))
+		, mhas_zero(false)
+		, mzero(0)
+	{}
+
+	//returns the element and true if it was inserted, false if it was present
+	//invalidates all iterators if the table has to grow
+	std::pair<const T*, bool> insert(T value_)
+	{
+		if (value_ == 0)
+		{
+			bool inserted = !mhas_zero;
+			mhas_zero = true;
+			return { &mzero, inserted };
+		}
+		auto r = mtable.insert(value_);
+		return { r.first, !r.second };
+	}
+
+	//invalidates all iterators
+	bool erase(T value_)
+	{
+		if (value_ == 0)
+		{
+			bool erased = mhas_zero;
+			mhas_zero = false;
+			return erased;
+		}
+		return mtable.erase(value_);
+	}
+
+	//the element equal to value_, nullptr if there is none
+	const T* find(T value_) const
+	{
+		if (value_ == 0)
+			return mhas_zero ? &mzero : nullptr;
+		auto r = mtable.find(value_);
+		return r.second ? r.first : nullptr;
+	}
+
+	bool contains(T value_) const
+	{
+		return value_ == 0 ? mhas_zero : mtable.contains(value_);
+	}
+
+	size_t count(T value_) const
+	{
+		return contains(value_);
+	}
+
+	//see hot_set::hash_value
+	size_t hash_value(T value_) const
+	{
+		return mtable.hash_value(value_);
+	}
+
+	void prefetch_hash(size_t hash_) const
+	{
+		mtable.prefetch_hash(hash_);
+	}
+
+	//hash_ must be hash_value(value_)
+	bool contains_hash(T value_, size_t hash_) const
+	{
+		return value_ == 0 ? mhas_zero : mtable.contains_hash(value_, hash_);
+	}
+
+	size_t size() const
+	{
+		return mtable.size() + mhas_zero;
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	//number of elements the table may contain before reallocating
+	size_t capacity() const
+	{
+		return mtable.capacity();
+	}
+
+	//number of slots allocated by the table
+	size_t allocated() const
+	{
+		return mtable.allocated();
+	}
+
+	//invalidates all iterators if the table has to grow
+	void reserve(size_t count_)
+	{
+		mtable.reserve(count_);
+	}
+
+	void clear()
+	{
+		mtable.clear();
+		mhas_zero = false;
+	}
+
+	const table_type& table() const
+	{
+		return mtable;
+	}
+
+	iterator begin() const
+	{
+		return iterator(mtable.begin(), mtable.end(), mhas_zero ? &mzero : nullptr);
+	}
+
+	iterator end() const
+	{
+		return iterator(mtable.end(), mtable.end(), nullptr);
+	}
+};
@@ -7,7 +7,27 @@
 #include <utility>
 #include <memory>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
 #include "algorithm_ext.h"
+#include "allocators.h"
+#include "instrumentation.h"
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+//with HOT_SET_DIAGNOSTICS defined, every hot_set measures its probe lengths
+//when it is full and about to grow, and prints a warning to std::cerr if they
+//exceed the thresholds below (see hot_set::warn_if_clustered)
+#ifndef HOT_SET_WARN_MEAN_PROBE
+#define HOT_SET_WARN_MEAN_PROBE 4.0
+#endif
+#ifndef HOT_SET_WARN_MAX_PROBE
+#define HOT_SET_WARN_MAX_PROBE 64
+#endif
 
 struct default_load_policy
 {
@@ -44,6 +64,37 @@ struct default_load_policy
 	}
 };
 
+//default_load_policy, but slots are selected from the high bits of the hash
+//multiplied by 2^64/phi (fibonacci hashing) instead of its low bits.
+//use it when the hasher may be the identity: with std::hash<T*> or std::hash<int>
+//aligned pointers or strided keys only differ in bits the mask would drop
+struct fibonacci_load_policy : default_load_policy
+{
+	template<class T>
+	T* select(T* begin, T* end, size_t hash) const
+	{
+		//allocated sizes are powers of two, so ctz is log2
+		auto bits = __builtin_ctzll(size_t(end - begin));
+		if (bits == 0)
+			return begin;
+		return begin + ((uint64_t(hash) * 11400714819323198485ull) >> (64 - bits));
+	}
+};
+
+//whether hot_set may grow a table in place: only if, after doubling, the element
+//selecting slot i selects slot i or i + old size. that holds for the masking
+//select of default_load_policy itself; any other policy must opt in with
+//in_place_growth = true, and one derived from default_load_policy does not
+//inherit it since it may override select (fibonacci_load_policy spreads slot i
+//over 2i and 2i + 1)
+template<class Load, class = void>
+struct load_grows_in_place : std::is_same<Load, default_load_policy>
+{};
+
+template<class Load>
+struct load_grows_in_place<Load, std::void_t<decltype(Load::in_place_growth)>> : std::integral_constant<bool, Load::in_place_growth>
+{};
+
 template<class T>
 struct variable
 {
@@ -77,6 +128,95 @@ struct span
 	T* end() { return last;  }
 };
 
+//integral keys, a tombstone known at compile time (hoc_set) and plain ==:
+//probe_find then runs a loop of compares against a register and a constant
+//instead of calling Tomb and Equal per slot, several slots at a time with SIMD
+template<class T, class Tomb, class Equal>
+struct is_integral_probe : std::false_type
+{};
+
+template<class T, T tomb>
+struct is_integral_probe<T, std::integral_constant<T, tomb>, std::equal_to<void>> : std::is_integral<T>
+{};
+
+template<class T, T tomb>
+struct is_integral_probe<T, std::integral_constant<T, tomb>, std::equal_to<T>> : std::is_integral<T>
+{};
+
+namespace hot_detail
+{
+
+//bit i of match(p, key, tomb) is set if p[i] is key or tomb, for i < lanes.
+//lanes is 0 where there is no SIMD compare for T's size
+template<class T, size_t Size = sizeof(T)>
+struct simd_match
+{
+	enum : size_t { lanes = 0 };
+
+	static unsigned match(const T*, T, T)
+	{
+		return 0;
+	}
+};
+
+#if defined(__AVX2__)
+template<class T>
+struct simd_match<T, 4>
+{
+	enum : size_t { lanes = 8 };
+
+	static unsigned match(const T* p_, T key_, T tomb_)
+	{
+		auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p_));
+		auto m = _mm256_or_si256(_mm256_cmpeq_epi32(v, _mm256_set1_epi32(int32_t(key_))), _mm256_cmpeq_epi32(v, _mm256_set1_epi32(int32_t(tomb_))));
+		return unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+	}
+};
+
+template<class T>
+struct simd_match<T, 8>
+{
+	enum : size_t { lanes = 4 };
+
+	static unsigned match(const T* p_, T key_, T tomb_)
+	{
+		auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p_));
+		auto m = _mm256_or_si256(_mm256_cmpeq_epi64(v, _mm256_set1_epi64x(int64_t(key_))), _mm256_cmpeq_epi64(v, _mm256_set1_epi64x(int64_t(tomb_))));
+		return unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+	}
+};
+#elif defined(__SSE2__)
+template<class T>
+struct simd_match<T, 4>
+{
+	enum : size_t { lanes = 4 };
+
+	static unsigned match(const T* p_, T key_, T tomb_)
+	{
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_));
+		auto m = _mm_or_si128(_mm_cmpeq_epi32(v, _mm_set1_epi32(int32_t(key_))), _mm_cmpeq_epi32(v, _mm_set1_epi32(int32_t(tomb_))));
+		return unsigned(_mm_movemask_ps(_mm_castsi128_ps(m)));
+	}
+};
+
+#if defined(__SSE4_1__)
+template<class T>
+struct simd_match<T, 8>
+{
+	enum : size_t { lanes = 2 };
+
+	static unsigned match(const T* p_, T key_, T tomb_)
+	{
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_));
+		auto m = _mm_or_si128(_mm_cmpeq_epi64(v, _mm_set1_epi64x(int64_t(key_))), _mm_cmpeq_epi64(v, _mm_set1_epi64x(int64_t(tomb_))));
+		return unsigned(_mm_movemask_pd(_mm_castsi128_pd(m)));
+	}
+};
+#endif
+#endif
+
+}
+
 //hot stands for hash, open-addressing w/ tombstone
 //note: this class is untested and incomplete
 
@@ -86,10 +226,21 @@ template<
 	class Equal = std::equal_to<void>,//element comparator
 	class Alloc = std::allocator<T>, //allocator
 	class Hash = std::hash<T>,	//hasher
-	class Load = default_load_policy//controls load factor and related concerns
+	class Load = default_load_policy,//controls load factor and related concerns
+	class Instr = no_instrumentation//counts rehashes and probe steps, see instrumentation.h
 >
 class hot_set
 {
+public:
+	typedef T value_type;
+	typedef Tomb tombstone_type;
+	typedef Hash hasher;
+	typedef Equal key_equal;
+	typedef Load load_policy_type;
+	typedef Alloc allocator_type;
+	typedef Instr instrumentation_type;
+
+private:
 	T* mbegin;
 	T* mend;
 	size_t mcapacity;
@@ -99,6 +250,7 @@ class hot_set
 	Equal eq;
 	Tomb tomb_gen;
 	Alloc allocator;
+	Instr instr;
 
 	void init(size_t size)
 	{
@@ -112,8 +264,25 @@ class hot_set
 		}
 	}
 
-	void rehash(size_t newsize)
+	//doubling in place needs an allocator that can resize its block (see
+	//allocators.h), elements that may be moved bytewise, and a load policy that
+	//keeps every element in its slot or sends it to slot + old size
+	static constexpr bool can_grow_in_place = allocator_can_reallocate<Alloc>::value
+		&& std::is_trivially_copyable<T>::value
+		&& load_grows_in_place<Load>::value;
+
+	void reallocate(size_t newsize)
 	{
+		if constexpr (can_grow_in_place)
+		{
+			auto oldsize = size_t(mend - mbegin);
+			if (oldsize > 0 && newsize == oldsize * 2 && grow_in_place(newsize))
+			{
+				return;
+			}
+		}
+
+		typename Instr::scope timer(instr, instr_event::rehash);
 		auto oldbegin = mbegin;
 		auto oldend = mend;
 		mcapacity = load_alg.occupancy(newsize);
@@ -135,16 +304,63 @@ class hot_set
 		}
 		mbegin = b;
 		mend = e;
+		stdext::destroy(oldbegin, oldend);
 		allocator.deallocate(oldbegin, oldend-oldbegin);
 	}
+
+	//resizes the slot array to newsize == 2 * allocated() and moves every
+	//element to its slot in the doubled table, so peak memory is the new array
+	//rather than old + new. returns false, changing nothing, if the table has
+	//no empty slot to start from
+	bool grow_in_place(size_t newsize)
+	{
+		auto oldsize = size_t(mend - mbegin);
+		auto tomb = tombstone();
+		auto equal = eq;
+		size_t start = 0;
+		while (start != oldsize && !equal(tomb, mbegin[start]))
+		{
+			++start;
+		}
+		if (start == oldsize)
+		{
+			return false;
+		}
+
+		typename Instr::scope timer(instr, instr_event::rehash);
+		auto b = allocator.reallocate(mbegin, oldsize, newsize);
+		auto e = b + newsize;
+		std::uninitialized_fill(b + oldsize, e, tomb);
+		mbegin = b;
+		mend = e;
+		mcapacity = load_alg.occupancy(newsize);
+
+		//reinsert the old half in probe order, starting after an empty slot so
+		//that no cluster is entered in the middle. an element selecting the old
+		//half lands at or before the slot it leaves; one selecting the new half
+		//lands at most old size past it. either way no element already placed
+		//probes across a slot that is still to be vacated
+		for (size_t i = 1; i <= oldsize; ++i)
+		{
+			auto& slot = b[(start + i) % oldsize];
+			if (!equal(tomb, slot))
+			{
+				T value = slot;
+				slot = tomb;
+				*probe_find(b, e, value).first = value;
+			}
+		}
+		return true;
+	}
 	void remove_internal(T* first_, T* element_, T* last_)
 	{
 		--moccupied;
 		auto tomb = tomb_gen();
 		*element_ = tomb;
 
-		//rehash elements that may have collided
-		probe(first_, element_, last_, [&](T& value)
+		//rehash elements that may have collided, i.e. the rest of the cluster
+		auto next = element_ + 1 == last_ ? first_ : element_ + 1;
+		probe(first_, next, last_, [&](T& value)
 		{
 			auto temp = std::move(value);
 			value = tomb;
@@ -153,21 +369,38 @@ class hot_set
 	}
 	auto probe_find(T* first_, T* last_, const T& in_) const
 	{
-		auto start = load_alg.select(first_, last_, hash(in_));
+		if (first_ == last_)
+		{
+			return std::make_pair(last_, false);
+		}
+		return probe_find(first_, last_, in_, hash(in_));
+	}
+	//hash_ is hash(in_), and first_ != last_
+	std::pair<T*, bool> probe_find(T* first_, T* last_, const T& in_, size_t hash_) const
+	{
+		auto start = load_alg.select(first_, last_, hash_);
+		if constexpr (is_integral_probe<T, Tomb, Equal>::value)
+		{
+			return probe_find_integral(first_, start, last_, in_);
+		}
 		auto equal = eq;
 		auto tomb = tomb_gen();
 		auto current = start;
+		size_t steps = 0;
 		for (int i = 0; i < 2; ++i)
 		{
 			while (current != last_)
 			{
 				auto& value = *current;
+				++steps;
 				if (equal(tomb, value))
 				{
+					instr.probe_steps(steps);
 					return std::make_pair(current, false);
 				}
 				else if (equal(in_, value))
 				{
+					instr.probe_steps(steps);
 					return std::make_pair(current, true);
 				}
 				++current;
@@ -176,6 +409,49 @@ class hot_set
 			current = first_;
 		};
 
+		instr.probe_steps(steps);
+		return std::make_pair(last_, false);
+	}
+
+	//probe_find for is_integral_probe: stops at the first slot holding key_ or
+	//the tombstone, found lanes at a time while the run doesn't reach last_
+	std::pair<T*, bool> probe_find_integral(T* first_, T* start_, T* last_, T key_) const
+	{
+		constexpr T tomb = Tomb::value;
+		typedef hot_detail::simd_match<T> simd;
+		auto current = start_;
+		size_t steps = 0;
+		for (int i = 0; i < 2; ++i)
+		{
+			if constexpr (simd::lanes > 0)
+			{
+				while (size_t(last_ - current) >= simd::lanes)
+				{
+					if (auto m = simd::match(current, key_, tomb))
+					{
+						auto lane = size_t(__builtin_ctz(m));
+						current += lane;
+						instr.probe_steps(steps + lane + 1);
+						return std::make_pair(current, *current != tomb);
+					}
+					current += simd::lanes;
+					steps += simd::lanes;
+				}
+			}
+			for (; current != last_; ++current)
+			{
+				++steps;
+				if (*current == key_ || *current == tomb)
+				{
+					instr.probe_steps(steps);
+					return std::make_pair(current, *current != tomb);
+				}
+			}
+			last_ = start_;
+			current = first_;
+		}
+
+		instr.probe_steps(steps);
 		return std::make_pair(last_, false);
 	}
 
@@ -223,7 +499,11 @@ public:
 		}
 		void advance()
 		{
-			current = std::find_if(current, set.mend, [&](T& elem) { return !set.is_invalid(elem); });
+			//by reference: variable<T> hands out its stored tombstone, which
+			//for strings would otherwise be copied on every increment
+			decltype(auto) tomb = set.tomb_gen();
+			const auto& equal = set.eq;
+			current = std::find_if(current, set.mend, [&](const T& elem) { return !equal(tomb, elem); });
 		}
 		iterator operator++(int)
 		{
@@ -317,6 +597,135 @@ public:
 		return eq(tomb_gen(), value_);
 	}
 
+	//snapshot of how well the table is doing, see stats()
+	struct table_stats
+	{
+		enum { histogram_size = 16 };
+
+		//number of elements, slots, and elements allowed before growing
+		size_t size;
+		size_t allocated;
+		size_t capacity;
+
+		//free slots, i.e. slots holding the tombstone value
+		size_t tombstones;
+
+		//number of runs of occupied slots and length of the longest one;
+		//a miss scans to the end of its run
+		size_t clusters;
+		size_t max_cluster;
+
+		//probe length of an element is 1 + its distance from the slot the load
+		//policy selects for it, i.e. the slots a successful find inspects.
+		//probe_histogram[i] counts sampled elements with probe length i + 1, the
+		//last bucket everything longer
+		size_t sampled;
+		size_t probe_total;
+		size_t max_probe;
+		size_t probe_histogram[histogram_size];
+
+		//bytes of the set object plus its slot array; memory owned by the
+		//elements themselves (e.g. long std::string) is not included
+		size_t bytes;
+
+		double load_factor() const
+		{
+			return allocated ? double(size) / allocated : 0.0;
+		}
+
+		double mean_probe() const
+		{
+			return sampled ? double(probe_total) / sampled : 0.0;
+		}
+
+		double mean_cluster() const
+		{
+			return clusters ? double(size) / clusters : 0.0;
+		}
+
+		double bytes_per_element() const
+		{
+			return size ? double(bytes) / size : 0.0;
+		}
+	};
+
+	//one pass over the slot array. cluster figures are exact; probe lengths need
+	//a hash per element, so only every sample_every-th element is hashed to keep
+	//this cheap on large live tables
+	table_stats stats(size_t sample_every_ = 1) const
+	{
+		table_stats r = {};
+		r.size = moccupied;
+		r.allocated = mend - mbegin;
+		r.capacity = mcapacity;
+		r.bytes = sizeof(*this) + r.allocated * sizeof(T);
+		if (r.allocated == 0)
+			return r;
+
+		sample_every_ = std::max<size_t>(sample_every_, 1);
+		auto tomb = tomb_gen();
+		size_t n = r.allocated;
+		size_t run = 0;
+		size_t first_run = 0;
+		size_t seen = 0;
+		bool wrapped_run = !eq(tomb, *mbegin) && !eq(tomb, *(mend - 1));
+
+		for (T* it = mbegin; it != mend; ++it)
+		{
+			if (eq(tomb, *it))
+			{
+				++r.tombstones;
+				if (run > 0)
+				{
+					if (first_run == 0 && r.clusters == 0)
+						first_run = run;
+					++r.clusters;
+					r.max_cluster = std::max(r.max_cluster, run);
+				}
+				run = 0;
+				continue;
+			}
+
+			++run;
+			if (seen++ % sample_every_ != 0)
+				continue;
+
+			size_t home = load_alg.select(mbegin, mend, hash(*it)) - mbegin;
+			size_t length = ((it - mbegin) + n - home) % n + 1;
+			++r.sampled;
+			r.probe_total += length;
+			r.max_probe = std::max(r.max_probe, length);
+			++r.probe_histogram[std::min<size_t>(length, table_stats::histogram_size) - 1];
+		}
+
+		if (run > 0)
+		{
+			//the run at the end continues at the beginning of the array
+			if (wrapped_run && r.clusters > 0)
+				run += first_run;
+			else
+				++r.clusters;
+			r.max_cluster = std::max(r.max_cluster, run);
+		}
+		return r;
+	}
+
+	//prints a warning to os_ and returns true if probe lengths exceed
+	//HOT_SET_WARN_MEAN_PROBE on average or HOT_SET_WARN_MAX_PROBE at worst,
+	//which usually means the hasher and the load policy don't fit the keys
+	bool warn_if_clustered(std::ostream& os_ = std::cerr) const
+	{
+		auto s = stats();
+		if (s.mean_probe() <= HOT_SET_WARN_MEAN_PROBE && s.max_probe <= HOT_SET_WARN_MAX_PROBE)
+			return false;
+
+		os_ << "hot_set: clustered table, " << s.size << " elements in " << s.allocated
+			<< " slots, mean probe " << s.mean_probe() << ", max probe " << s.max_probe
+			<< ", longest cluster " << s.max_cluster
+			<< " (check the hash function or use fibonacci_load_policy)" << std::endl;
+		return true;
+	}
+
 	//number of elements allocated by the set
 	size_t allocated() const
 	{
@@ -340,13 +749,90 @@ public:
 		return{ mbegin, mend };
 	}
 
+	span<const T> raw_view() const
+	{
+		return{ mbegin, mend };
+	}
+
+	const Load& load_policy() const
+	{
+		return load_alg;
+	}
+
+	const Instr& instrumentation() const
+	{
+		return instr;
+	}
+
+	//replaces the slot array wholesale without rehashing, e.g. from a snapshot
+	//construct_ must construct every slot in [first, last) with either an element
+	//or the tombstone, laid out as this set (same Hash and Load) would place them
+	//invalidates all iterators
+	template<class Func>
+	void assign_slots(size_t allocated_, size_t occupied_, Func construct_)
+	{
+		stdext::destroy(mbegin, mend);
+		allocator.deallocate(mbegin, mend - mbegin);
+		mbegin = mend = nullptr;
+		mcapacity = moccupied = 0;
+
+		if (allocated_ > 0)
+		{
+			auto b = allocator.allocate(allocated_);
+			try
+			{
+				construct_(b, b + allocated_);
+			}
+			catch (...)
+			{
+				allocator.deallocate(b, allocated_);
+				throw;
+			}
+			mbegin = b;
+			mend = b + allocated_;
+			mcapacity = load_alg.occupancy(allocated_);
+			moccupied = occupied_;
+		}
+	}
+
 	void shrink()
 	{
 		auto target_size = load_alg.allocated(mcapacity);
 		if (target_size != (mend - mbegin) )
 		{
-			rehash(target_size);
+			reallocate(target_size);
+		}
+	}
+
+	//makes room for count_ elements, so that many inserts won't reallocate
+	//invalidates all iterators if the set has to grow
+	void reserve(size_t count_)
+	{
+		if (count_ > mcapacity)
+		{
+			reallocate(load_alg.allocated(count_));
+		}
+	}
+
+	//reallocates to the number of slots the load policy chooses for
+	//max(count_, size()) elements; unlike reserve this may shrink the set
+	//invalidates all iterators
+	void rehash(size_t count_)
+	{
+		auto target_size = load_alg.allocated(std::max(count_, size()));
+		if (target_size == size_t(mend - mbegin))
+		{
+			return;
+		}
+		if (target_size == 0)
+		{
+			stdext::destroy(mbegin, mend);
+			allocator.deallocate(mbegin, mend - mbegin);
+			mbegin = mend = nullptr;
+			mcapacity = 0;
+			return;
 		}
+		reallocate(target_size);
 	}
 
 	//Inserts an element into the set
@@ -356,7 +842,10 @@ public:
 	{
 		if (mcapacity == moccupied)
 		{
-			rehash(load_alg.grow(mend - mbegin));
+#ifdef HOT_SET_DIAGNOSTICS
+			warn_if_clustered();
+#endif
+			reallocate(load_alg.grow(mend - mbegin));
 		}
 		return stable_insert(std::forward<U>(value_));
 	}
@@ -375,7 +864,7 @@ public:
 	//removes element. invalidates all iterators.
 	void erase(const T* element_)
 	{
-		remove_internal(mbegin, element_, mend);
+		remove_internal(mbegin, mbegin + (element_ - mbegin), mend);
 	}
 	//removes element == value. invalidates all iterators.
 	bool erase(const T& value_)
@@ -390,6 +879,111 @@ public:
 		}
 		return false;
 	}
+	//removes every element for which pred_(element) is true and returns how
+	//many. one sweep over the slot array, starting after an empty slot so that
+	//no cluster is entered in the middle: within a cluster, once an element has
+	//been removed every later survivor is moved to the first free slot from its
+	//home, which is at or before its own. no element is rehashed twice and no
+	//cluster is scanned again, unlike erasing the elements one by one
+	//invalidates all iterators
+	template<class Pred>
+	size_t erase_if(Pred pred_)
+	{
+		auto b = mbegin;
+		auto e = mend;
+		auto n = size_t(e - b);
+		auto tomb = tomb_gen();
+		auto equal = eq;
+		size_t erased = 0;
+
+		size_t start = 0;
+		while (start != n && !equal(tomb, b[start]))
+		{
+			++start;
+		}
+		if (start == n)
+		{
+			//a full table is a single cluster: open it with a first removal
+			auto first = std::find_if(b, e, [&](const T& value) { return pred_(static_cast<const T&>(value)); });
+			if (first == e)
+			{
+				return 0;
+			}
+			remove_internal(b, first, e);
+			return 1 + erase_if(std::move(pred_));
+		}
+
+		bool hole = false;
+		for (size_t i = 1; i <= n; ++i)
+		{
+			auto& slot = b[(start + i) % n];
+			if (equal(tomb, slot))
+			{
+				hole = false;
+			}
+			else if (pred_(static_cast<const T&>(slot)))
+			{
+				slot = tomb;
+				++erased;
+				hole = true;
+			}
+			else if (hole)
+			{
+				auto value = std::move(slot);
+				slot = tomb;
+				*probe_find(b, e, value).first = std::move(value);
+			}
+		}
+		moccupied -= erased;
+		return erased;
+	}
+
+	//calls f_(element) for every element, in slot order. for hoc_set with an
+	//integral key the empty slots are skipped with SIMD compares
+	template<class Func>
+	void for_each(Func f_) const
+	{
+		auto current = mbegin;
+		auto last = mend;
+		if constexpr (is_integral_probe<T, Tomb, Equal>::value)
+		{
+			constexpr T tomb = Tomb::value;
+			typedef hot_detail::simd_match<T> simd;
+			if constexpr (simd::lanes > 0)
+			{
+				constexpr unsigned all = (1u << simd::lanes) - 1;
+				for (; size_t(last - current) >= simd::lanes; current += simd::lanes)
+				{
+					auto full = ~simd::match(current, tomb, tomb) & all;
+					while (full)
+					{
+						f_(static_cast<const T&>(current[__builtin_ctz(full)]));
+						full &= full - 1;
+					}
+				}
+			}
+			for (; current != last; ++current)
+			{
+				if (*current != tomb)
+				{
+					f_(static_cast<const T&>(*current));
+				}
+			}
+		}
+		else
+		{
+			auto tomb = tomb_gen();
+			auto equal = eq;
+			for (; current != last; ++current)
+			{
+				if (!equal(tomb, *current))
+				{
+					f_(static_cast<const T&>(*current));
+				}
+			}
+		}
+	}
+
 	size_t change_tombstone(Tomb tomb_gen_)
 	{
 		auto b = mbegin;
@@ -428,10 +1022,10 @@ public:
 		return moccupied == 0;
 	}
 
-	//invalidates all iterators
-	bool clear()
+	//keeps the slot array, invalidates all iterators
+	void clear()
 	{
-		std::fill(begin, end, tomb_gen());
+		std::fill(mbegin, mend, tomb_gen());
 		moccupied = 0;
 	}
 
@@ -445,6 +1039,10 @@ public:
 	template<class Func>
 	void find_each(const T& value_, Func predicate_) const
 	{
+		if (mbegin == mend)
+		{
+			return;
+		}
 		auto start = load_alg.select(mbegin, mend, hash(value_));
 		auto equal = eq;
 		probe(mbegin, start, mend, [&](const T& found) {
@@ -458,16 +1056,31 @@ public:
 	{
 		return find(value_).second;
 	}
+
+	//split lookups, for probing a batch of keys: hash them all, prefetch the
+	//home slot of each, then look them up while the lines arrive (set_algebra.h)
+	size_t hash_value(const T& value_) const
+	{
+		return hash(value_);
+	}
+	void prefetch_hash(size_t hash_) const
+	{
+		if (mbegin != mend)
+		{
+			__builtin_prefetch(load_alg.select(mbegin, mend, hash_));
+		}
+	}
+	//hash_ must be hash_value(value_)
+	bool contains_hash(const T& value_, size_t hash_) const
+	{
+		return mbegin != mend && probe_find(mbegin, mend, value_, hash_).second;
+	}
 	auto count(const T& value_) const
 	{
 		size_t num = 0;
-		Equal equal = eq;
-		probe(value_, [&](const T& found)
+		find_each(value_, [&](const T&)
 		{
-			if (equal(found, value_))
-			{
-				++num;
-			}
+			++num;
 		});
 		return num;
 	}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "futils.h"
+#include "hot_set.h"
+
+//flat on-disk image of a hot_set's slot array
+//
+//the slots are written in place, tombstones included, so loading is a copy
+//(or one string construction per slot) and never calls the hasher. a snapshot
+//is therefore only meaningful to a set using the same Hash, Equal and Load as
+//the one that wrote it; the load policy is checked through occupancy(), the
+//hasher is the caller's responsibility.
+//
+//layout, all integers native endian:
+//  header
+//  trivially copyable T: tombstone, then allocated slots, each aligned to T
+//  std::string:          uint64 offsets[allocated + 2] into the blob, then the
+//                        blob; entry i spans [offsets[i], offsets[i + 1]) and the
+//                        last entry is the tombstone
+
+namespace snapshot
+{
+
+enum class slot_kind : uint32_t
+{
+	trivial = 0,
+	string = 1
+};
+
+struct header
+{
+	char magic[8];
+	uint32_t version;
+	slot_kind kind;
+	uint64_t value_size;
+	uint64_t allocated;		//number of slots
+	uint64_t occupied;		//number of elements
+	uint64_t capacity;		//load policy occupancy(allocated) at save time
+	uint64_t reserved;
+};
+
+static const char magic[8] = { 'H', 'O', 'T', 'S', 'N', 'A', 'P', '\0' };
+enum { version = 1 };
+
+namespace detail
+{
+
+inline size_t align_up(size_t n, size_t a)
+{
+	return (n + a - 1) / a * a;
+}
+
+inline void write_padding(std::ofstream& ofs, size_t from, size_t to)
+{
+	static const char zeros[64] = {};
+	while (from < to)
+	{
+		auto n = std::min<size_t>(to - from, sizeof(zeros));
+		ofs.write(zeros, n);
+		from += n;
+	}
+}
+
+template<class T>
+struct traits
+{
+	static_assert(std::is_trivially_copyable<T>::value, "snapshot: T must be trivially copyable or std::string");
+	static const slot_kind kind = slot_kind::trivial;
+
+	template<class Set>
+	static void save(std::ofstream& ofs, const Set& set)
+	{
+		auto offset = detail::align_up(sizeof(header), alignof(T));
+		write_padding(ofs, sizeof(header), offset);
+
+		T tomb = set.tombstone();
+		ofs.write(reinterpret_cast<const char*>(&tomb), sizeof(T));
+
+		auto slots = set.raw_view();
+		ofs.write(reinterpret_cast<const char*>(slots.first), (slots.last - slots.first) * sizeof(T));
+	}
+
+	template<class Set>
+	static void load(const io::mapped_file& file, const header& h, Set& set)
+	{
+		auto offset = detail::align_up(sizeof(header), alignof(T));
+		//h.allocated is checked before multiplying so that a corrupt count
+		//cannot wrap the size around
+		if (file.size() < offset + sizeof(T) || (file.size() - offset) / sizeof(T) - 1 < h.allocated)
+			throw std::runtime_error("snapshot: truncated slot array");
+
+		const char* p = file.data() + offset;
+		T tomb;
+		std::memcpy(&tomb, p, sizeof(T));
+		if (!set.is_invalid(tomb))
+			throw std::runtime_error("snapshot: tombstone mismatch");
+
+		const char* slots = p + sizeof(T);
+		set.assign_slots(h.allocated, h.occupied, [&](T* first, T* last)
+		{
+			std::memcpy(static_cast<void*>(first), slots, (last - first) * sizeof(T));
+		});
+	}
+};
+
+template<>
+struct traits<std::string>
+{
+	static const slot_kind kind = slot_kind::string;
+
+	template<class Set>
+	static void save(std::ofstream& ofs, const Set& set)
+	{
+		auto slots = set.raw_view();
+		const std::string& tomb = set.tombstone();
+
+		std::vector<uint64_t> offsets;
+		offsets.reserve((slots.last - slots.first) + 2);
+		uint64_t total = 0;
+		offsets.push_back(total);
+		for (auto it = slots.first; it != slots.last; ++it)
+		{
+			total += it->size();
+			offsets.push_back(total);
+		}
+		total += tomb.size();
+		offsets.push_back(total);
+
+		ofs.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+		for (auto it = slots.first; it != slots.last; ++it)
+			ofs.write(it->data(), it->size());
+		ofs.write(tomb.data(), tomb.size());
+	}
+
+	template<class Set>
+	static void load(const io::mapped_file& file, const header& h, Set& set)
+	{
+		auto body_size = file.size() - sizeof(header);
+		if (body_size / sizeof(uint64_t) < 2 || body_size / sizeof(uint64_t) - 2 < h.allocated)
+			throw std::runtime_error("snapshot: truncated offset table");
+		auto table_size = (h.allocated + 2) * sizeof(uint64_t);
+
+		const uint64_t* offsets = reinterpret_cast<const uint64_t*>(file.data() + sizeof(header));
+		const char* blob = file.data() + sizeof(header) + table_size;
+		auto blob_size = body_size - table_size;
+
+		//every entry must lie in the blob, not only the last one
+		for (uint64_t i = 0; i <= h.allocated; ++i)
+			if (offsets[i] > offsets[i + 1])
+				throw std::runtime_error("snapshot: corrupt offset table");
+		if (offsets[h.allocated + 1] > blob_size)
+			throw std::runtime_error("snapshot: truncated string blob");
+
+		std::string tomb(blob + offsets[h.allocated], blob + offsets[h.allocated + 1]);
+		if (!set.is_invalid(tomb))
+			throw std::runtime_error("snapshot: tombstone mismatch");
+
+		set.assign_slots(h.allocated, h.occupied, [&](std::string* first, std::string* last)
+		{
+			auto current = first;
+			try
+			{
+				for (size_t i = 0; current != last; ++i, ++current)
+					::new (static_cast<void*>(current)) std::string(blob + offsets[i], blob + offsets[i + 1]);
+			}
+			catch (...)
+			{
+				stdext::destroy(first, current);
+				throw;
+			}
+		});
+	}
+};
+
+}
+
+//writes the slot array of set_ to filename
+//throws std::runtime_error on I/O failure
+template<class T, class Tomb, class Equal, class Alloc, class Hash, class Load, class Instr>
+void save(const hot_set<T, Tomb, Equal, Alloc, Hash, Load, Instr>& set_, const std::string& filename)
+{
+	typedef detail::traits<T> traits;
+
+	std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+	if (!ofs)
+		throw std::runtime_error("snapshot: cannot open " + filename);
+
+	header h = {};
+	std::memcpy(h.magic, magic, sizeof(magic));
+	h.version = version;
+	h.kind = traits::kind;
+	h.value_size = sizeof(T);
+	h.allocated = set_.allocated();
+	h.occupied = set_.size();
+	h.capacity = set_.capacity();
+	ofs.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+	traits::save(ofs, set_);
+
+	ofs.flush();
+	if (!ofs)
+		throw std::runtime_error("snapshot: write failed for " + filename);
+}
+
+//replaces the contents of set_ with the snapshot in filename
+//the file is mapped rather than read, slots are copied out of the mapping
+//throws std::system_error if the file cannot be mapped and std::runtime_error
+//if it is not a compatible snapshot
+template<class T, class Tomb, class Equal, class Alloc, class Hash, class Load, class Instr>
+void load(const std::string& filename, hot_set<T, Tomb, Equal, Alloc, Hash, Load, Instr>& set_)
+{
+	typedef detail::traits<T> traits;
+
+	io::mapped_file file(filename);
+	file.advise(MADV_SEQUENTIAL);
+	if (file.size() < sizeof(header))
+		throw std::runtime_error("snapshot: truncated header in " + filename);
+
+	header h;
+	std::memcpy(&h, file.data(), sizeof(h));
+	if (std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != version)
+		throw std::runtime_error("snapshot: bad magic or version in " + filename);
+	if (h.kind != traits::kind || h.value_size != sizeof(T))
+		throw std::runtime_error("snapshot: value type mismatch in " + filename);
+
+	Load load_alg = set_.load_policy();
+	if (load_alg.occupancy(h.allocated) != h.capacity || h.occupied > h.capacity)
+		throw std::runtime_error("snapshot: load policy mismatch in " + filename);
+
+	traits::load(file, h, set_);
+}
+
+}
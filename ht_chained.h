@@ -1,12 +1,19 @@
 #include <functional>
 #include <vector>
 #include <algorithm>
+#include <numeric>
 #include <iostream>
+#include <memory>
 
-template <typename K>//, typename V>
+#include "instrumentation.h"
+
+// Alloc allocates the keys of each bucket; the bucket array uses it rebound
+template <typename K, typename Hash = std::hash<K>, typename Instr = no_instrumentation, typename Alloc = std::allocator<K>>//, typename V>
 struct ht_chained
 {
 	typedef K key_type;
+	typedef Hash hasher;
+	typedef Alloc allocator_type;
 	//typedef V mapped_type;
 	//typedef std::pair<K, V> value_type;
 	typedef int size_type;
@@ -15,7 +22,7 @@ struct ht_chained
 	{
 		//typedef std::pair<K, V> value_type;
         typedef K value_type;
-        typedef typename std::vector<value_type>::size_type size_type;
+        typedef typename std::vector<value_type, Alloc>::size_type size_type;
 
 		//V& insert(const K& k)
         void insert(const K& k)
@@ -32,25 +39,44 @@ struct ht_chained
             //return it->second;
         }
 
-        bool find(const K& k) const
+        bool erase(const K& k)
+        {
+            auto it = std::find(m_values.begin(), m_values.end(), k);
+            if (it == m_values.end())
+                return false;
+
+            // order within a bucket doesn't matter
+            if (it != m_values.end() - 1)
+                *it = std::move(m_values.back());
+            m_values.pop_back();
+            return true;
+        }
+
+        bool find(const K& k, const Instr& instr) const
         {
             auto it = std::find_if(m_values.begin(), m_values.end(), [&k](const value_type& p) { return p == k; });
+            instr.probe_steps((it - m_values.begin()) + (it != m_values.end()));
             return it != m_values.end();
         }
 
 		bool full() const { return m_values.size() == 8; }
 		size_type size() const { return m_values.size(); }
 
-		std::vector<value_type> m_values;
+		std::vector<value_type, Alloc> m_values;
 	};
 
-	std::vector<bucket> m_buckets;
+	typedef std::vector<bucket, typename std::allocator_traits<Alloc>::template rebind_alloc<bucket>> bucket_vector;
+
+	bucket_vector m_buckets;
 	double m_growing_factor;
+	Hash m_hash;
+	Instr m_instr;
 
 public:
-	ht_chained(double growing_factor = 2.0)
+	ht_chained(double growing_factor = 2.0, Hash hash = Hash())
 	: m_buckets(32),
-	  m_growing_factor(growing_factor)
+	  m_growing_factor(growing_factor),
+	  m_hash(std::move(hash))
 	{}
 
     void operator[](const K& k)
@@ -65,14 +91,36 @@ public:
 
     bool find(const K& k) const
     {
-        std::size_t s = std::hash<K>()(k);
+        std::size_t s = m_hash(k);
         const bucket& b = m_buckets[s % m_buckets.size()];
-        return b.find(k);
+        return b.find(k, m_instr);
+    }
+
+    bool erase(const K& k)
+    {
+        std::size_t s = m_hash(k);
+        return m_buckets[s % m_buckets.size()].erase(k);
     }
 
 	size_type size() const { return std::accumulate(m_buckets.begin(), m_buckets.end(), 0, [](size_type s, const bucket& b) { return s + b.size(); }); }
 	size_type bucket_count() const { return m_buckets.size(); }
 
+	// rebuilds with count buckets (at least one); a bucket that still overflows
+	// grows the table as usual
+	void rehash(std::size_t count)
+	{
+		rebuild(m_buckets, std::max<std::size_t>(count, 1));
+	}
+
+	// sizes the table for count keys, one bucket per key on average, which keeps
+	// the odds of any bucket reaching 8 keys and forcing an expansion small
+	void reserve(std::size_t count)
+	{
+		if (count > m_buckets.size())
+			rehash(count);
+	}
+	const Instr& instrumentation() const { return m_instr; }
+
 	template <typename F>
 	void visit(F&& f)
 	{
@@ -87,10 +135,10 @@ public:
 	}
 
 private:
-	//V& insert(std::vector<bucket>& buckets, const K& k)
-    void insert(std::vector<bucket>& buckets, const K& k)
+	//V& insert(bucket_vector& buckets, const K& k)
+    void insert(bucket_vector& buckets, const K& k)
     {
-        std::size_t s = std::hash<K>()(k);
+        std::size_t s = m_hash(k);
         bucket& b = buckets[s % buckets.size()];
 
         if (b.full())
@@ -102,9 +150,18 @@ private:
         return b.insert(k);
     }
 
-	void expand(std::vector<bucket>& buckets)
+	void expand(bucket_vector& buckets)
+	{
+		typename Instr::scope timer(m_instr, instr_event::expand);
+		// at least one more bucket: a small table times a small factor truncates
+		// back to its own size, and the rebuild would expand again forever
+		std::size_t count = buckets.size() * m_growing_factor;
+		rebuild(buckets, std::max(count, buckets.size() + 1));
+	}
+
+	void rebuild(bucket_vector& buckets, std::size_t count)
 	{
-		std::vector<bucket> newbuckets(buckets.size() * m_growing_factor);
+		bucket_vector newbuckets(count);
 
 		for (bucket& b : buckets)
 			for (auto& p : b.m_values)
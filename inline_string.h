@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "string_arena.h"
+
+//fixed size string key for open-addressing tables
+//
+//N bytes in total: up to N - 1 characters are stored inline, zero padded, with
+//the length in the last byte. longer strings keep a pointer and 32-bit length instead,
+//marked by an all-ones last byte; the pointed-to characters are not owned and
+//normally live in a string_arena. the representation is canonical (a string is
+//inline iff it fits), so equality of inline keys is a plain compare of N bytes
+//and never leaves the slot.
+//
+//the default value is the empty string, which makes variable<inline_string<N>>
+//a valid tombstone for hot_set.
+template<size_t N>
+class inline_string
+{
+	static_assert(N >= 16 && N % 8 == 0 && N < 256, "inline_string: N must be a multiple of 8 in [16, 248]");
+
+	enum : unsigned char { external_tag = 0xff };
+
+	alignas(8) unsigned char mdata[N];
+
+	unsigned char tag() const
+	{
+		return mdata[N - 1];
+	}
+
+	void assign(const char* str_, size_t size_)
+	{
+		std::memset(mdata, 0, N);
+		if (size_ < N)
+		{
+			std::memcpy(mdata, str_, size_);
+			mdata[N - 1] = static_cast<unsigned char>(size_);
+		}
+		else
+		{
+			uint32_t size = static_cast<uint32_t>(size_);
+			std::memcpy(mdata, &str_, sizeof(str_));
+			std::memcpy(mdata + 8, &size, sizeof(size));
+			mdata[N - 1] = external_tag;
+		}
+	}
+
+	static bool equal_bytes(const unsigned char* a, const unsigned char* b)
+	{
+		size_t i = 0;
+#ifdef __AVX2__
+		for (; i + 32 <= N; i += 32)
+		{
+			auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+			auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+			if (unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb))) != 0xffffffffu)
+				return false;
+		}
+#endif
+#ifdef __SSE2__
+		for (; i + 16 <= N; i += 16)
+		{
+			auto va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+			auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xffff)
+				return false;
+		}
+#endif
+		for (; i < N; i += 8)
+		{
+			uint64_t x, y;
+			std::memcpy(&x, a + i, 8);
+			std::memcpy(&y, b + i, 8);
+			if (x != y)
+				return false;
+		}
+		return true;
+	}
+
+public:
+	//number of characters that fit in the slot
+	static constexpr size_t inline_capacity = N - 1;
+
+	inline_string()
+	{
+		std::memset(mdata, 0, N);
+	}
+
+	//long strings are referenced, not copied: str_ must outlive this key.
+	//that is fine for lookups; use the arena constructor for keys that are stored
+	inline_string(std::string_view str_)
+	{
+		assign(str_.data(), str_.size());
+	}
+
+	inline_string(const std::string& str_)
+	{
+		assign(str_.data(), str_.size());
+	}
+
+	inline_string(const char* str_)
+	{
+		assign(str_, std::strlen(str_));
+	}
+
+	//long strings are interned into arena_
+	inline_string(std::string_view str_, string_arena& arena_)
+	{
+		if (str_.size() < N)
+			assign(str_.data(), str_.size());
+		else
+		{
+			auto interned = arena_.intern(str_);
+			assign(interned.data(), interned.size());
+		}
+	}
+
+	bool is_inline() const
+	{
+		return tag() != external_tag;
+	}
+
+	size_t size() const
+	{
+		if (is_inline())
+			return tag();
+		uint32_t size;
+		std::memcpy(&size, mdata + 8, sizeof(size));
+		return size_t(size);
+	}
+
+	bool empty() const
+	{
+		return tag() == 0;
+	}
+
+	const char* data() const
+	{
+		if (is_inline())
+			return reinterpret_cast<const char*>(mdata);
+		const char* p;
+		std::memcpy(&p, mdata, sizeof(p));
+		return p;
+	}
+
+	std::string_view view() const
+	{
+		return std::string_view(data(), size());
+	}
+
+	operator std::string_view() const
+	{
+		return view();
+	}
+
+	std::string str() const
+	{
+		return std::string(view());
+	}
+
+	friend bool operator==(const inline_string& a, const inline_string& b)
+	{
+		if (a.tag() != b.tag())
+			return false;
+		if (a.is_inline())
+			return equal_bytes(a.mdata, b.mdata);
+		return a.view() == b.view();
+	}
+
+	friend bool operator!=(const inline_string& a, const inline_string& b)
+	{
+		return !(a == b);
+	}
+
+	friend bool operator<(const inline_string& a, const inline_string& b)
+	{
+		return a.view() < b.view();
+	}
+};
+
+namespace std
+{
+	template<size_t N>
+	struct hash<inline_string<N>>
+	{
+		size_t operator()(const inline_string<N>& s) const
+		{
+			return std::hash<std::string_view>()(s.view());
+		}
+	};
+}
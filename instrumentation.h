@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+//instrumentation policies for the containers: hot_set and ht_chained take one
+//as a template parameter, stx::btree through its traits (typedef instrumentation).
+//
+//containers report structural events through a scope object, constructed
+//around the event, and probe steps (slots or keys inspected by a lookup)
+//through probe_steps(). no_instrumentation does nothing and compiles away;
+//counting_instrumentation counts events and accumulates the time spent in them.
+
+enum class instr_event
+{
+	rehash,		//hot_set reallocating its slot array
+	expand,		//ht_chained growing its bucket array
+	split,		//btree splitting a full leaf or inner node
+	merge,		//btree merging two underfull siblings
+	rebuild,	//btree merge() rewriting the leaves of two overlapping trees
+	count_
+};
+
+struct instrumentation_stats
+{
+	enum { num_events = size_t(instr_event::count_) };
+
+	uint64_t events[num_events];
+	uint64_t nanoseconds[num_events];
+	uint64_t probe_steps;
+	uint64_t lookups;
+
+	uint64_t count(instr_event e) const
+	{
+		return events[size_t(e)];
+	}
+
+	double seconds(instr_event e) const
+	{
+		return nanoseconds[size_t(e)] * 1e-9;
+	}
+
+	double mean_probe_steps() const
+	{
+		return lookups ? double(probe_steps) / lookups : 0.0;
+	}
+};
+
+struct no_instrumentation
+{
+	struct scope
+	{
+		scope(const no_instrumentation&, instr_event) {}
+	};
+
+	void probe_steps(size_t) const {}
+
+	instrumentation_stats stats() const
+	{
+		return instrumentation_stats();
+	}
+
+	void reset() {}
+};
+
+class counting_instrumentation
+{
+	//mutable: lookups are const member functions of the containers
+	mutable instrumentation_stats mstats;
+
+public:
+	class scope
+	{
+		const counting_instrumentation& minstr;
+		instr_event mevent;
+		std::chrono::steady_clock::time_point mstart;
+
+	public:
+		scope(const counting_instrumentation& instr_, instr_event event_)
+			: minstr(instr_)
+			, mevent(event_)
+			, mstart(std::chrono::steady_clock::now())
+		{}
+
+		scope(const scope&) = delete;
+		scope& operator=(const scope&) = delete;
+
+		~scope()
+		{
+			auto elapsed = std::chrono::steady_clock::now() - mstart;
+			++minstr.mstats.events[size_t(mevent)];
+			minstr.mstats.nanoseconds[size_t(mevent)] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		}
+	};
+
+	counting_instrumentation()
+		: mstats()
+	{}
+
+	//one lookup that inspected steps_ slots or keys
+	void probe_steps(size_t steps_) const
+	{
+		mstats.probe_steps += steps_;
+		++mstats.lookups;
+	}
+
+	const instrumentation_stats& stats() const
+	{
+		return mstats;
+	}
+
+	void reset()
+	{
+		mstats = instrumentation_stats();
+	}
+};
@@ -0,0 +1,108 @@
+#include "futils.h"
+#include "hot_set.h"
+#include "numa_set.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// usage: numa_benchmark [threads per node] [fake nodes]
+// without fake nodes the machine's own topology is used
+
+template <typename Alloc>
+using int_hot_set = hot_set<uint64_t, std::integral_constant<uint64_t, 0>, std::equal_to<void>, Alloc>;
+
+const size_t key_count = size_t(1) << 22;
+const size_t lookups_per_thread = size_t(1) << 22;
+
+std::vector<uint64_t> random_keys(size_t n, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> v(n);
+    for (auto& k : v)
+        k = rng() | 1;
+    return v;
+}
+
+template <typename _SetT>
+void fill(_SetT& m)
+{
+    for (auto k : random_keys(key_count, 42))
+        m.insert(k);
+}
+
+// threads_per_node readers pinned to every node; get_set() is called once per
+// reader, after pinning, and returns the set that reader probes
+template <typename GetSet>
+void run_readers(const char* mode, const numa_topology& topology, size_t threads_per_node, GetSet get_set)
+{
+    const size_t nthreads = topology.nodes() * threads_per_node;
+    std::vector<double> ns_per_lookup(nthreads);
+
+    io::parallel_for_each_index(nthreads, [&](size_t i)
+    {
+        topology.pin_current_thread(i % topology.nodes());
+        const auto& m = get_set();
+
+        // hits and misses in equal parts, in an order no prefetcher can follow
+        auto keys = random_keys(lookups_per_thread / 2, 42);
+        auto misses = random_keys(lookups_per_thread / 2, 1000 + i);
+        keys.insert(keys.end(), misses.begin(), misses.end());
+        std::shuffle(keys.begin(), keys.end(), std::mt19937_64(i));
+
+        size_t found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (auto k : keys)
+            found += m.contains(k);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        asm volatile("" : : "r"(found));
+        ns_per_lookup[i] = std::chrono::duration<double, std::nano>(elapsed).count() / keys.size();
+    });
+
+    std::printf("%-14s", mode);
+    for (size_t node = 0; node < topology.nodes(); ++node)
+    {
+        double total = 0;
+        for (size_t i = node; i < nthreads; i += topology.nodes())
+            total += ns_per_lookup[i];
+        std::printf("%12.1f", total / threads_per_node);
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    const size_t threads_per_node = argc > 1 ? std::max(1, std::atoi(argv[1])) : 1;
+    const numa_topology topology = argc > 2 ? numa_topology::fake(std::max(1, std::atoi(argv[2]))) : numa_topology::system();
+
+    std::printf("%zu %snodes, %zu reader(s) per node, %zu keys\n", topology.nodes(), topology.is_fake() ? "fake " : "", threads_per_node, key_count);
+    std::printf("%-14s", "ns/lookup");
+    for (size_t node = 0; node < topology.nodes(); ++node)
+        std::printf("%9s %2zu", "node", node);
+    std::printf("\n");
+
+    // built by one thread pinned to node 0: first touch puts every page there
+    {
+        int_hot_set<std::allocator<uint64_t>> m;
+        topology.pin_current_thread(0);
+        fill(m);
+        run_readers("node 0", topology, threads_per_node, [&]() -> const auto& { return m; });
+    }
+
+    {
+        int_hot_set<numa_interleave_allocator<uint64_t>> m;
+        fill(m);
+        run_readers("interleaved", topology, threads_per_node, [&]() -> const auto& { return m; });
+    }
+
+    {
+        int_hot_set<std::allocator<uint64_t>> source;
+        fill(source);
+        numa_replicated<int_hot_set<std::allocator<uint64_t>>> replicated(source, topology);
+        run_readers("replicated", topology, threads_per_node, [&]() -> const auto& { return replicated.local(); });
+    }
+
+    return 0;
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <vector>
+
+#include <numa.h>
+#include <numaif.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "futils.h"
+
+//NUMA placement for read-mostly sets, on top of libnuma (link with -lnuma)
+//
+//numa_topology describes the nodes and their cpus. numa_interleave_allocator
+//spreads a slot array page by page over all nodes, so every reader pays the
+//average latency rather than half of them the remote one. numa_replicated
+//keeps one copy of a set per node and hands each thread the copy of the node
+//it runs on.
+//
+//numa_topology::fake(n) splits the cpus of a single-node machine into n
+//logical nodes, all backed by the memory of node 0: placement is meaningless
+//then, but routing and pinning behave as on a real n-node machine.
+
+class numa_topology
+{
+	std::vector<std::vector<int>> mcpus;	//cpus of each logical node
+	std::vector<int> mnode_of_cpu;			//logical node of each cpu, -1 if none
+	bool mfake;
+
+	numa_topology()
+		: mfake(false)
+	{}
+
+	static std::vector<int> allowed_cpus()
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		std::vector<int> cpus;
+		if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		{
+			for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+				if (CPU_ISSET(cpu, &set))
+					cpus.push_back(cpu);
+		}
+		if (cpus.empty())
+			cpus.push_back(0);
+		return cpus;
+	}
+
+	void index_cpus()
+	{
+		for (size_t node = 0; node < mcpus.size(); ++node)
+		{
+			for (int cpu : mcpus[node])
+			{
+				if (size_t(cpu) >= mnode_of_cpu.size())
+					mnode_of_cpu.resize(cpu + 1, -1);
+				if (mnode_of_cpu[cpu] < 0)
+					mnode_of_cpu[cpu] = int(node);
+			}
+		}
+	}
+
+	//node the calling thread was pinned to by pin_current_thread, -1 if none
+	static int& pinned_node()
+	{
+		thread_local int node = -1;
+		return node;
+	}
+
+public:
+	//the nodes and cpus libnuma reports; a single node holding every cpu if
+	//the kernel has no NUMA support
+	static numa_topology system()
+	{
+		numa_topology t;
+		if (numa_available() < 0)
+		{
+			t.mcpus.push_back(allowed_cpus());
+		}
+		else
+		{
+			std::unique_ptr<bitmask, void(*)(bitmask*)> mask(numa_allocate_cpumask(), numa_free_cpumask);
+			for (int node = 0; node <= numa_max_node(); ++node)
+			{
+				std::vector<int> cpus;
+				if (numa_node_to_cpus(node, mask.get()) == 0)
+				{
+					for (unsigned cpu = 0; cpu < mask->size; ++cpu)
+						if (numa_bitmask_isbitset(mask.get(), cpu))
+							cpus.push_back(int(cpu));
+				}
+				//memory-only nodes can't run readers
+				if (!cpus.empty())
+					t.mcpus.push_back(std::move(cpus));
+			}
+			if (t.mcpus.empty())
+				t.mcpus.push_back(allowed_cpus());
+		}
+		t.index_cpus();
+		return t;
+	}
+
+	//nodes_ logical nodes, cpus dealt round-robin; with fewer cpus than nodes
+	//some nodes share a cpu
+	static numa_topology fake(size_t nodes_)
+	{
+		numa_topology t;
+		t.mfake = true;
+		auto cpus = allowed_cpus();
+		t.mcpus.resize(std::max<size_t>(nodes_, 1));
+		for (size_t i = 0; i < std::max(cpus.size(), t.mcpus.size()); ++i)
+			t.mcpus[i % t.mcpus.size()].push_back(cpus[i % cpus.size()]);
+		t.index_cpus();
+		return t;
+	}
+
+	size_t nodes() const
+	{
+		return mcpus.size();
+	}
+
+	const std::vector<int>& cpus(size_t node_) const
+	{
+		return mcpus.at(node_);
+	}
+
+	bool is_fake() const
+	{
+		return mfake;
+	}
+
+	//restricts the calling thread to the cpus of node_. it then counts as
+	//running on node_, even on a fake topology where the cpu is shared
+	void pin_current_thread(size_t node_) const
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : cpus(node_))
+			CPU_SET(cpu, &set);
+		int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if (err != 0)
+			throw std::system_error(err, std::generic_category(), "numa_topology: pthread_setaffinity_np");
+		pinned_node() = int(node_);
+	}
+
+	//node the calling thread runs on: the one it was pinned to, otherwise the
+	//node of its current cpu
+	size_t current_node() const
+	{
+		auto pinned = pinned_node();
+		if (pinned >= 0 && size_t(pinned) < nodes())
+			return size_t(pinned);
+		int cpu = sched_getcpu();
+		if (cpu >= 0 && size_t(cpu) < mnode_of_cpu.size() && mnode_of_cpu[cpu] >= 0)
+			return size_t(mnode_of_cpu[cpu]);
+		return 0;
+	}
+};
+
+namespace detail
+{
+
+//blocks of at least this size are mapped and interleaved, smaller ones come from malloc
+static const size_t interleave_threshold = size_t(1) << 20;
+
+inline size_t round_to_pages(size_t bytes_)
+{
+	static const size_t page = size_t(sysconf(_SC_PAGESIZE));
+	return (bytes_ + page - 1) & ~(page - 1);
+}
+
+//best effort: without NUMA support the pages are simply local
+inline void interleave_pages(void* p_, size_t bytes_)
+{
+	if (numa_available() < 0)
+		return;
+	auto nodes = numa_get_mems_allowed();
+	mbind(p_, bytes_, MPOL_INTERLEAVE, nodes->maskp, nodes->size + 1, 0);
+	numa_bitmask_free(nodes);
+}
+
+}
+
+//blocks of 1MB or more are mapped with an interleave policy over all the nodes
+//the process may allocate from: page i lands on node i mod nodes. the policy
+//belongs to the mapping, so it holds for pages touched later, by any thread.
+//usable as hot_set's Alloc (and grows in place with mremap, which keeps it)
+template<class T>
+struct numa_interleave_allocator
+{
+	typedef T value_type;
+
+	template<class U>
+	struct rebind
+	{
+		typedef numa_interleave_allocator<U> other;
+	};
+
+	numa_interleave_allocator() = default;
+
+	template<class U>
+	numa_interleave_allocator(const numa_interleave_allocator<U>&)
+	{}
+
+	T* allocate(size_t n_)
+	{
+		auto bytes = n_ * sizeof(T);
+		if (bytes == 0)
+			return nullptr;
+		void* p;
+		if (bytes < detail::interleave_threshold)
+			p = std::malloc(bytes);
+		else
+		{
+			bytes = detail::round_to_pages(bytes);
+			p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED)
+				p = nullptr;
+			else
+				detail::interleave_pages(p, bytes);
+		}
+		if (!p)
+			throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p_, size_t n_)
+	{
+		auto bytes = n_ * sizeof(T);
+		if (p_ == nullptr)
+			return;
+		if (bytes < detail::interleave_threshold)
+			std::free(p_);
+		else
+			munmap(p_, detail::round_to_pages(bytes));
+	}
+
+	T* reallocate(T* p_, size_t old_n_, size_t new_n_)
+	{
+		auto old_bytes = old_n_ * sizeof(T);
+		auto new_bytes = new_n_ * sizeof(T);
+		if (old_bytes >= detail::interleave_threshold && new_bytes >= detail::interleave_threshold)
+		{
+			auto p = mremap(p_, detail::round_to_pages(old_bytes), detail::round_to_pages(new_bytes), MREMAP_MAYMOVE);
+			if (p == MAP_FAILED)
+				throw std::bad_alloc();
+			return static_cast<T*>(p);
+		}
+		auto p = allocate(new_n_);
+		if (p_ != nullptr)
+			std::memcpy(static_cast<void*>(p), p_, std::min(old_bytes, new_bytes));
+		deallocate(p_, old_n_);
+		return p;
+	}
+
+	template<class U>
+	void destroy(U* p_)
+	{
+		p_->~U();
+	}
+
+	template<class U>
+	bool operator==(const numa_interleave_allocator<U>&) const
+	{
+		return true;
+	}
+
+	template<class U>
+	bool operator!=(const numa_interleave_allocator<U>&) const
+	{
+		return false;
+	}
+};
+
+//one read-only copy of a set per node. each copy is made by a thread pinned to
+//its node, so the kernel's first-touch policy puts its memory there; readers
+//call local() and get the copy of the node they run on. the copies are
+//independent: a set changed after construction has to be replicated again
+template<class Set>
+class numa_replicated
+{
+	numa_topology mtopology;
+	std::vector<std::unique_ptr<const Set>> mreplicas;
+
+public:
+	explicit numa_replicated(const Set& source_, numa_topology topology_ = numa_topology::system())
+		: mtopology(std::move(topology_))
+		, mreplicas(mtopology.nodes())
+	{
+		io::parallel_for_each_index(mreplicas.size(), [&](size_t node)
+		{
+			mtopology.pin_current_thread(node);
+			mreplicas[node].reset(new Set(source_));
+		});
+	}
+
+	numa_replicated(const numa_replicated&) = delete;
+	numa_replicated& operator=(const numa_replicated&) = delete;
+
+	//the copy on the node the calling thread runs on
+	const Set& local() const
+	{
+		return *mreplicas[mtopology.current_node()];
+	}
+
+	const Set& replica(size_t node_) const
+	{
+		return *mreplicas.at(node_);
+	}
+
+	size_t replicas() const
+	{
+		return mreplicas.size();
+	}
+
+	const numa_topology& topology() const
+	{
+		return mtopology;
+	}
+};
@@ -0,0 +1,582 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "futils.h"
+#include "hash_functions.h"
+
+//immutable set over a key list known up front, built around a minimal perfect
+//hash function in the style of PTHash
+//
+//keys are hashed to 64 bits and split into buckets of a few keys each, with a
+//skewed split (60% of the keys go to 30% of the buckets) so that the large
+//buckets are placed first, while the table is nearly empty. every bucket then
+//gets the smallest 32-bit pilot under which all its keys land on free slots;
+//slot = fastrange(fmix64(hash ^ splitmix64(pilot)), table size). the table has
+//2% more slots than keys, since finding pilots for the last buckets of a
+//completely full table takes most of the build time; the few keys landing past
+//the first n slots are remapped to the n - those free slots below n, so the
+//keys still end up in n slots. a lookup reads one pilot from a small array and
+//compares the one key its slot holds, which is what makes the set exact for
+//absent keys too; 2% of the keys read the remap array as well.
+//
+//the whole set lives in one flat image, so it can be written to a file with
+//save() and used straight from a read-only mapping with map(). layout, all
+//integers native endian, every section 8-byte aligned:
+//  header
+//  uint32 pilots[buckets]
+//  uint64 remap[table size - size]
+//  trivially copyable T: keys[size]
+//  string-like T:        uint64 offsets[size + 1] into the blob, then the blob
+//
+//T may be trivially copyable (integers, inline_string) or convertible to
+//std::string_view (std::string, std::string_view), in which case the keys are
+//stored as characters and handed out as string_view. as for hot_set snapshots,
+//a mapped image is only meaningful to a set using the hasher that built it;
+//map() checks that the first key still hashes to its own slot.
+
+namespace perfect_hash
+{
+
+enum class key_kind : uint32_t
+{
+	trivial = 0,
+	string = 1
+};
+
+struct header
+{
+	char magic[8];
+	uint32_t version;
+	key_kind kind;
+	uint64_t value_size;
+	uint64_t size;			//number of keys and slots
+	uint64_t buckets;		//number of pilots
+	uint64_t blob_size;		//characters of string-like keys
+	uint64_t table_size;	//slots the pilots map to, size plus the remapped ones
+};
+
+static const char magic[8] = { 'P', 'E', 'R', 'F', 'S', 'E', 'T', '\0' };
+enum { version = 1 };
+
+//buckets = bucket_density * n / log2(n): fewer buckets make a smaller image and
+//a slower build, this is PTHash's usual trade-off
+enum { bucket_density = 6 };
+
+namespace detail
+{
+
+inline size_t align8(size_t n)
+{
+	return (n + 7) & ~size_t(7);
+}
+
+inline uint64_t fastrange(uint64_t x, uint64_t n)
+{
+	return uint64_t((__uint128_t(x) * n) >> 64);
+}
+
+template<class T>
+using is_string_key = std::is_convertible<const T&, std::string_view>;
+
+}
+
+}
+
+template<
+	class T,	//key type, trivially copyable or convertible to std::string_view
+	class Hash = hashing::wy_hash,	//hasher, see hash_functions.h
+	class Equal = std::equal_to<void>	//key comparator
+>
+class perfect_set
+{
+	static constexpr bool string_keys = perfect_hash::detail::is_string_key<T>::value;
+	static_assert(string_keys || std::is_trivially_copyable<T>::value, "perfect_set: T must be trivially copyable or convertible to std::string_view");
+	static_assert(alignof(T) <= 8, "perfect_set: image sections are only 8-byte aligned");
+
+public:
+	typedef T value_type;
+	typedef Hash hasher;
+	typedef Equal key_equal;
+	//what lookups take and key() returns
+	typedef std::conditional_t<string_keys, std::string_view, const T&> key_arg;
+
+	static const size_t npos = size_t(-1);
+
+private:
+	//the image is either owned (built or copied) or a file mapping
+	std::unique_ptr<uint64_t[]> mowned;
+	io::mapped_file mfile;
+	const char* mimage;
+	size_t mbytes;
+
+	const uint32_t* mpilots;
+	const uint64_t* mremap;
+	const T* mkeys;
+	const uint64_t* moffsets;
+	const char* mblob;
+	uint64_t msize;
+	uint64_t mtable_size;
+	uint64_t mbuckets;
+	uint64_t mdense_buckets;	//buckets receiving the first 60% of the hash range
+
+	Hash hash;
+	Equal eq;
+
+	//0.6 * 2^64
+	static const uint64_t dense_fraction = 0x9999999999999999ull;
+
+	static uint64_t key_hash(const Hash& hash_, key_arg key_)
+	{
+		return hashing::fmix64(uint64_t(hash_(key_)));
+	}
+
+	static uint64_t dense_buckets(uint64_t buckets_)
+	{
+		return buckets_ * 3 / 10;
+	}
+
+	//the high half of the hash picks the part of the table, the low half the
+	//bucket within it
+	static uint64_t bucket_of(uint64_t h_, uint64_t buckets_, uint64_t dense_)
+	{
+		auto r = (h_ << 32) | (h_ >> 32);
+		return h_ < dense_fraction
+			? perfect_hash::detail::fastrange(r, dense_)
+			: dense_ + perfect_hash::detail::fastrange(r, buckets_ - dense_);
+	}
+
+	static uint64_t slot_of(uint64_t h_, uint64_t pilot_mix_, uint64_t size_)
+	{
+		return perfect_hash::detail::fastrange(hashing::fmix64(h_ ^ pilot_mix_), size_);
+	}
+
+	static uint64_t table_size_for(uint64_t size_)
+	{
+		return size_ + size_ / 50;
+	}
+
+	static uint64_t bucket_count_for(uint64_t size_)
+	{
+		if (size_ < 2)
+			return 1;
+		uint64_t log2 = 63 - __builtin_clzll(size_);
+		return std::max<uint64_t>(1, (perfect_hash::bucket_density * size_ + log2 - 1) / log2);
+	}
+
+	bool matches(size_t slot_, key_arg key_) const
+	{
+		if constexpr (string_keys)
+			return eq(key(slot_), key_);
+		else
+			return eq(mkeys[slot_], key_);
+	}
+
+	//points the section pointers into image_, checking the header and sizes
+	void attach(const char* image_, size_t bytes_)
+	{
+		if (bytes_ < sizeof(perfect_hash::header))
+			throw std::runtime_error("perfect_set: truncated header");
+
+		perfect_hash::header h;
+		std::memcpy(&h, image_, sizeof(h));
+		if (std::memcmp(h.magic, perfect_hash::magic, sizeof(perfect_hash::magic)) != 0 || h.version != perfect_hash::version)
+			throw std::runtime_error("perfect_set: bad magic or version");
+		if (h.kind != (string_keys ? perfect_hash::key_kind::string : perfect_hash::key_kind::trivial) || h.value_size != sizeof(T))
+			throw std::runtime_error("perfect_set: key type mismatch");
+		if (h.buckets != bucket_count_for(h.size) || h.table_size != table_size_for(h.size))
+			throw std::runtime_error("perfect_set: table size mismatch");
+
+		//every section is at least a byte per entry, which bounds the sizes
+		//below before they are multiplied
+		if (h.size > bytes_ || h.table_size > bytes_ || h.blob_size > bytes_)
+			throw std::runtime_error("perfect_set: truncated image");
+
+		size_t offset = sizeof(perfect_hash::header);
+		auto pilots = offset;
+		offset = perfect_hash::detail::align8(offset + h.buckets * sizeof(uint32_t));
+		auto remap = offset;
+		offset += (h.table_size - h.size) * sizeof(uint64_t);
+		auto keys = offset;
+		if constexpr (string_keys)
+			offset += (h.size + 1) * sizeof(uint64_t) + h.blob_size;
+		else
+			offset += h.size * sizeof(T);
+		if (bytes_ < offset)
+			throw std::runtime_error("perfect_set: truncated image");
+
+		//index_of follows the remap entries and key() the offsets without checks
+		auto remap_entries = reinterpret_cast<const uint64_t*>(image_ + remap);
+		for (size_t i = 0; i < h.table_size - h.size; ++i)
+			if (remap_entries[i] >= h.size)
+				throw std::runtime_error("perfect_set: corrupt remap array");
+
+		if constexpr (string_keys)
+		{
+			auto offsets = reinterpret_cast<const uint64_t*>(image_ + keys);
+			for (size_t i = 0; i < h.size; ++i)
+				if (offsets[i] > offsets[i + 1])
+					throw std::runtime_error("perfect_set: corrupt offset table");
+			if (offsets[h.size] != h.blob_size)
+				throw std::runtime_error("perfect_set: corrupt offset table");
+			moffsets = offsets;
+			mblob = image_ + keys + (h.size + 1) * sizeof(uint64_t);
+		}
+		else
+		{
+			mkeys = reinterpret_cast<const T*>(image_ + keys);
+		}
+		mimage = image_;
+		mbytes = bytes_;
+		mpilots = reinterpret_cast<const uint32_t*>(image_ + pilots);
+		mremap = remap_entries;
+		msize = h.size;
+		mtable_size = h.table_size;
+		mbuckets = h.buckets;
+		mdense_buckets = dense_buckets(h.buckets);
+	}
+
+	char* allocate_image(size_t bytes_)
+	{
+		mowned.reset(new uint64_t[(bytes_ + 7) / 8]());
+		return reinterpret_cast<char*>(mowned.get());
+	}
+
+	//keys_ must not contain duplicates
+	void build(const std::vector<T>& keys_)
+	{
+		struct entry
+		{
+			uint64_t hash;
+			uint64_t bucket;
+			size_t key;
+		};
+
+		uint64_t n = keys_.size();
+		uint64_t table = table_size_for(n);
+		uint64_t buckets = bucket_count_for(n);
+		uint64_t dense = dense_buckets(buckets);
+
+		std::vector<entry> entries(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			auto h = key_hash(hash, keys_[i]);
+			entries[i] = { h, bucket_of(h, buckets, dense), i };
+		}
+
+		//group the keys by bucket; two keys of a bucket with the same hash would
+		//always share a slot whatever the pilot
+		std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b)
+		{
+			return a.bucket != b.bucket ? a.bucket < b.bucket : a.hash < b.hash;
+		});
+		for (size_t i = 1; i < n; ++i)
+		{
+			if (entries[i].hash == entries[i - 1].hash)
+				throw std::runtime_error("perfect_set: 64-bit hash collision between distinct keys");
+		}
+
+		std::vector<size_t> first(buckets + 1, 0);
+		for (auto& e : entries)
+			++first[e.bucket + 1];
+		for (uint64_t b = 0; b < buckets; ++b)
+			first[b + 1] += first[b];
+
+		std::vector<uint64_t> order(buckets);
+		for (uint64_t b = 0; b < buckets; ++b)
+			order[b] = b;
+		std::stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b)
+		{
+			return first[a + 1] - first[a] > first[b + 1] - first[b];
+		});
+
+		std::vector<uint32_t> pilots(buckets, 0);
+		std::vector<uint64_t> slot_of_entry(n);
+		std::vector<uint64_t> taken((table + 63) / 64, 0);
+		for (auto b : order)
+		{
+			auto begin = first[b];
+			auto end = first[b + 1];
+			if (begin == end)
+				continue;
+
+			for (uint64_t pilot = 0;; ++pilot)
+			{
+				if (pilot > UINT32_MAX)
+					throw std::runtime_error("perfect_set: no pilot found for a bucket");
+
+				auto mix = hashing::splitmix64(pilot);
+				auto i = begin;
+				for (; i != end; ++i)
+				{
+					auto s = slot_of(entries[i].hash, mix, table);
+					auto bit = uint64_t(1) << (s % 64);
+					if (taken[s / 64] & bit)
+						break;
+					taken[s / 64] |= bit;
+					slot_of_entry[i] = s;
+				}
+				if (i == end)
+				{
+					pilots[b] = uint32_t(pilot);
+					break;
+				}
+				for (auto j = begin; j != i; ++j)
+					taken[slot_of_entry[j] / 64] &= ~(uint64_t(1) << (slot_of_entry[j] % 64));
+			}
+		}
+
+		//pair the keys past n with the free slots below n, in order
+		std::vector<uint64_t> remap(table - n, 0);
+		uint64_t free = 0;
+		for (uint64_t s = n; s < table; ++s)
+		{
+			if (!(taken[s / 64] & (uint64_t(1) << (s % 64))))
+				continue;
+			while (taken[free / 64] & (uint64_t(1) << (free % 64)))
+				++free;
+			remap[s - n] = free++;
+		}
+
+		std::vector<size_t> key_at(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			auto s = slot_of_entry[i];
+			key_at[s < n ? s : remap[s - n]] = entries[i].key;
+		}
+
+		perfect_hash::header h = {};
+		std::memcpy(h.magic, perfect_hash::magic, sizeof(perfect_hash::magic));
+		h.version = perfect_hash::version;
+		h.kind = string_keys ? perfect_hash::key_kind::string : perfect_hash::key_kind::trivial;
+		h.value_size = sizeof(T);
+		h.size = n;
+		h.buckets = buckets;
+		h.table_size = table;
+		if constexpr (string_keys)
+		{
+			for (auto& k : keys_)
+				h.blob_size += std::string_view(k).size();
+		}
+
+		size_t remap_offset = perfect_hash::detail::align8(sizeof(perfect_hash::header) + buckets * sizeof(uint32_t));
+		size_t keys_offset = remap_offset + remap.size() * sizeof(uint64_t);
+		size_t bytes = keys_offset;
+		if constexpr (string_keys)
+			bytes += (n + 1) * sizeof(uint64_t) + h.blob_size;
+		else
+			bytes += n * sizeof(T);
+
+		char* image = allocate_image(bytes);
+		std::memcpy(image, &h, sizeof(h));
+		std::memcpy(image + sizeof(perfect_hash::header), pilots.data(), buckets * sizeof(uint32_t));
+		if (!remap.empty())
+			std::memcpy(image + remap_offset, remap.data(), remap.size() * sizeof(uint64_t));
+		if constexpr (string_keys)
+		{
+			auto offsets = reinterpret_cast<uint64_t*>(image + keys_offset);
+			auto blob = image + keys_offset + (n + 1) * sizeof(uint64_t);
+			uint64_t total = 0;
+			for (size_t s = 0; s < n; ++s)
+			{
+				std::string_view k(keys_[key_at[s]]);
+				offsets[s] = total;
+				std::memcpy(blob + total, k.data(), k.size());
+				total += k.size();
+			}
+			offsets[n] = total;
+		}
+		else
+		{
+			for (size_t s = 0; s < n; ++s)
+				std::memcpy(image + keys_offset + s * sizeof(T), &keys_[key_at[s]], sizeof(T));
+		}
+
+		attach(image, bytes);
+	}
+
+	perfect_set(const Hash& hash_, const Equal& equal_)
+		: mimage(nullptr)
+		, mbytes(0)
+		, mpilots(nullptr)
+		, mremap(nullptr)
+		, mkeys(nullptr)
+		, moffsets(nullptr)
+		, mblob(nullptr)
+		, msize(0)
+		, mtable_size(0)
+		, mbuckets(0)
+		, mdense_buckets(0)
+		, hash(hash_)
+		, eq(equal_)
+	{}
+
+public:
+	perfect_set()
+		: perfect_set(Hash(), Equal())
+	{}
+
+	//builds the set from the keys in [first_, last_); duplicates are dropped
+	//throws std::runtime_error if two distinct keys have the same 64-bit hash
+	template<class It>
+	perfect_set(It first_, It last_, Hash hash_ = Hash(), Equal equal_ = Equal())
+		: perfect_set(hash_, equal_)
+	{
+		std::vector<T> keys(first_, last_);
+		auto less = [](const T& a, const T& b)
+		{
+			if constexpr (string_keys)
+				return std::string_view(a) < std::string_view(b);
+			else
+				return std::memcmp(&a, &b, sizeof(T)) < 0;
+		};
+		auto same = [this](const T& a, const T& b)
+		{
+			if constexpr (string_keys)
+				return eq(std::string_view(a), std::string_view(b));
+			else
+				return eq(a, b);
+		};
+		std::sort(keys.begin(), keys.end(), less);
+		keys.erase(std::unique(keys.begin(), keys.end(), same), keys.end());
+		build(keys);
+	}
+
+	perfect_set(const perfect_set& in)
+		: perfect_set(in.hash, in.eq)
+	{
+		if (in.mimage)
+		{
+			char* image = allocate_image(in.mbytes);
+			std::memcpy(image, in.mimage, in.mbytes);
+			attach(image, in.mbytes);
+		}
+	}
+
+	perfect_set(perfect_set&& in)
+		: perfect_set(in.hash, in.eq)
+	{
+		swap(in);
+	}
+
+	perfect_set& operator=(perfect_set other_)
+	{
+		swap(other_);
+		return *this;
+	}
+
+	//both images stay where they are, so the section pointers remain valid
+	void swap(perfect_set& other_)
+	{
+		using std::swap;
+		swap(mowned, other_.mowned);
+		swap(mfile, other_.mfile);
+		swap(mimage, other_.mimage);
+		swap(mbytes, other_.mbytes);
+		swap(mpilots, other_.mpilots);
+		swap(mremap, other_.mremap);
+		swap(mkeys, other_.mkeys);
+		swap(moffsets, other_.moffsets);
+		swap(mblob, other_.mblob);
+		swap(msize, other_.msize);
+		swap(mtable_size, other_.mtable_size);
+		swap(mbuckets, other_.mbuckets);
+		swap(mdense_buckets, other_.mdense_buckets);
+		swap(hash, other_.hash);
+		swap(eq, other_.eq);
+	}
+
+	//uses the image in filename through a read-only mapping, without copying it
+	//throws std::system_error if the file cannot be mapped and std::runtime_error
+	//if it is not a compatible image
+	static perfect_set map(const std::string& filename_, Hash hash_ = Hash(), Equal equal_ = Equal())
+	{
+		perfect_set set(hash_, equal_);
+		set.mfile = io::mapped_file(filename_);
+		set.attach(set.mfile.data(), set.mfile.size());
+		if (set.msize > 0 && set.index_of(set.key(0)) != 0)
+			throw std::runtime_error("perfect_set: hasher mismatch in " + filename_);
+		return set;
+	}
+
+	//writes the image to filename
+	//throws std::runtime_error on I/O failure
+	void save(const std::string& filename_) const
+	{
+		std::ofstream ofs(filename_, std::ios::binary | std::ios::trunc);
+		if (!ofs)
+			throw std::runtime_error("perfect_set: cannot open " + filename_);
+		if (mimage)
+		{
+			ofs.write(mimage, mbytes);
+		}
+		else
+		{
+			//an empty set still gets a valid image
+			perfect_set empty(static_cast<const T*>(nullptr), static_cast<const T*>(nullptr), hash, eq);
+			ofs.write(empty.mimage, empty.mbytes);
+		}
+		ofs.flush();
+		if (!ofs)
+			throw std::runtime_error("perfect_set: write failed for " + filename_);
+	}
+
+	size_t size() const
+	{
+		return msize;
+	}
+
+	bool empty() const
+	{
+		return msize == 0;
+	}
+
+	//bytes of the image: header, pilots, remap array and keys
+	size_t bytes() const
+	{
+		return mbytes;
+	}
+
+	//the key in slot_, for slot_ in [0, size())
+	key_arg key(size_t slot_) const
+	{
+		if constexpr (string_keys)
+			return std::string_view(mblob + moffsets[slot_], moffsets[slot_ + 1] - moffsets[slot_]);
+		else
+			return mkeys[slot_];
+	}
+
+	//the slot of key_ in [0, size()), npos if key_ is not in the set
+	//slots are a minimal perfect hash of the keys, usable to index side arrays
+	size_t index_of(key_arg key_) const
+	{
+		if (msize == 0)
+			return npos;
+		auto h = key_hash(hash, key_);
+		auto pilot = mpilots[bucket_of(h, mbuckets, mdense_buckets)];
+		auto s = slot_of(h, hashing::splitmix64(pilot), mtable_size);
+		if (s >= msize)
+			s = mremap[s - msize];
+		return matches(s, key_) ? s : npos;
+	}
+
+	bool contains(key_arg key_) const
+	{
+		return index_of(key_) != npos;
+	}
+
+	size_t count(key_arg key_) const
+	{
+		return contains(key_);
+	}
+};
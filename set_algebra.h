@@ -0,0 +1,461 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "container_ops.h"
+
+//bulk intersection, difference and union of two sets. every element of the
+//result is passed to out_(element), and each function returns their number.
+//the naive loop of finds over one set pays a full random lookup per key; these
+//use what the layout of each kind of set offers instead:
+//
+//hashed_*: any set container_ops knows. the smaller set is walked (for the
+//difference a_ - b_, a_ is) and the other probed in batches: a batch of keys is
+//hashed and their home slots prefetched before the first is looked up, so up to
+//probe_batch cache misses are in flight at once. sets with split lookups
+//(hot_set and hot_int_set: hash_value, prefetch_hash, contains_hash) get this,
+//others are probed key by key. the result is in no particular order.
+//
+//merge_*: ordered sets. both are walked in order; a side that falls behind by
+//gallop_after elements catches up with lower_bound(hint, key), which on
+//stx::btree_set moves along the leaf chain and only descends from the root when
+//the key is farther ahead. the result is in order.
+//
+//sorted_*: sorted arrays without duplicates. the intersection of 4 and 8-byte
+//integers compares blocks of both arrays all against all with SIMD; when one
+//array is skew_ratio times the size of the other, every element of the small
+//one is found in the large one by galloping instead. the result is in order.
+
+namespace set_algebra
+{
+
+enum : size_t
+{
+	probe_batch = 16,
+	gallop_after = 8,
+	skew_ratio = 32
+};
+
+namespace detail
+{
+
+template<class C, class = void>
+struct has_split_lookup : std::false_type
+{};
+
+template<class C>
+struct has_split_lookup<C, std::void_t<decltype(std::declval<const C&>().contains_hash(*std::declval<const C&>().begin(), size_t()))>> : std::true_type
+{};
+
+template<class It, class = void>
+struct has_key : std::false_type
+{};
+
+template<class It>
+struct has_key<It, std::void_t<decltype(std::declval<const It&>().key())>> : std::true_type
+{};
+
+//the key at it_, without the copy stx::btree iterators make for operator*
+template<class It>
+decltype(auto) key_at(const It& it_)
+{
+	if constexpr (has_key<It>::value)
+		return it_.key();
+	else
+		return *it_;
+}
+
+//detected with the key rather than *it_, which for maps is the pair
+template<class C, class It, class = void>
+struct has_hinted_lower_bound : std::false_type
+{};
+
+template<class C, class It>
+struct has_hinted_lower_bound<C, It, std::void_t<decltype(std::declval<const C&>().lower_bound(std::declval<It>(), key_at(std::declval<const It&>())))>> : std::true_type
+{};
+
+//calls f_(key, found in set_) for every key of [first_, last_)
+template<class Set, class It, class F>
+void probe_each(const Set& set_, It first_, It last_, F&& f_)
+{
+	if constexpr (has_split_lookup<Set>::value)
+	{
+		//the batch holds addresses, so they must come from key_at: the value an
+		//stx::btree iterator returns by reference lives in the iterator itself
+		typedef std::remove_reference_t<decltype(key_at(first_))> key_type;
+		key_type* keys[probe_batch];
+		size_t hashes[probe_batch];
+		while (first_ != last_)
+		{
+			size_t n = 0;
+			for (; n < probe_batch && first_ != last_; ++n, ++first_)
+			{
+				keys[n] = &key_at(first_);
+				hashes[n] = set_.hash_value(*keys[n]);
+				set_.prefetch_hash(hashes[n]);
+			}
+			for (size_t i = 0; i < n; ++i)
+				f_(*keys[i], set_.contains_hash(*keys[i], hashes[i]));
+		}
+	}
+	else
+	{
+		for (; first_ != last_; ++first_)
+			f_(key_at(first_), container_ops::contains(set_, key_at(first_)));
+	}
+}
+
+//it_ advanced to the first element of set_ not less than key_, for merges that
+//have already stepped past gallop_after smaller elements in a row: the gap is
+//then likely long enough for a search to beat stepping
+template<class Set, class It, class K>
+It seek(const Set& set_, It it_, const K& key_)
+{
+	if constexpr (has_hinted_lower_bound<Set, It>::value)
+		return set_.lower_bound(it_, key_);
+	else
+		return set_.lower_bound(key_);
+}
+
+//first_ advanced to the first element not less than key_: steps of 1, 2, 4...
+//until one overshoots, then a binary search of the last step
+template<class T>
+const T* gallop(const T* first_, const T* last_, const T& key_)
+{
+	size_t step = 1;
+	const T* lo = first_;
+	while (lo + step < last_ && lo[step] < key_)
+	{
+		lo += step;
+		step <<= 1;
+	}
+	return std::lower_bound(lo, std::min(lo + step, last_), key_);
+}
+
+//mask of the lanes of a_ equal to some lane of b_, comparing every rotation of
+//b_ against a_; lanes == 0 where no SIMD path exists
+template<class T, size_t Size = sizeof(T)>
+struct block_match
+{
+	enum : size_t { lanes = 0 };
+
+	static unsigned match(const T*, const T*)
+	{
+		return 0;
+	}
+};
+
+#if defined(__AVX2__)
+template<class T>
+struct block_match<T, 4>
+{
+	enum : size_t { lanes = 8 };
+
+	static unsigned match(const T* a_, const T* b_)
+	{
+		auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_));
+		auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b_));
+		auto rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+		auto eq = _mm256_cmpeq_epi32(a, b);
+		for (int i = 1; i < 8; ++i)
+		{
+			b = _mm256_permutevar8x32_epi32(b, rotate);
+			eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(a, b));
+		}
+		return unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+	}
+};
+
+template<class T>
+struct block_match<T, 8>
+{
+	enum : size_t { lanes = 4 };
+
+	static unsigned match(const T* a_, const T* b_)
+	{
+		auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_));
+		auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b_));
+		auto eq = _mm256_or_si256(_mm256_cmpeq_epi64(a, b), _mm256_cmpeq_epi64(a, _mm256_permute4x64_epi64(b, 0x39)));
+		eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(a, _mm256_permute4x64_epi64(b, 0x4e)));
+		eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(a, _mm256_permute4x64_epi64(b, 0x93)));
+		return unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(eq)));
+	}
+};
+#elif defined(__SSE2__)
+template<class T>
+struct block_match<T, 4>
+{
+	enum : size_t { lanes = 4 };
+
+	static unsigned match(const T* a_, const T* b_)
+	{
+		auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_));
+		auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b_));
+		auto eq = _mm_or_si128(_mm_cmpeq_epi32(a, b), _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, 0x39)));
+		eq = _mm_or_si128(eq, _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, 0x4e)));
+		eq = _mm_or_si128(eq, _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, 0x93)));
+		return unsigned(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+	}
+};
+#endif
+
+}
+
+//elements of both a_ and b_, those of the smaller one
+template<class SetA, class SetB, class Out>
+size_t hashed_intersection(const SetA& a_, const SetB& b_, Out out_)
+{
+	if (b_.size() < a_.size())
+		return hashed_intersection(b_, a_, std::move(out_));
+	size_t n = 0;
+	detail::probe_each(b_, a_.begin(), a_.end(), [&](const auto& key, bool found)
+	{
+		if (found)
+		{
+			out_(key);
+			++n;
+		}
+	});
+	return n;
+}
+
+//elements of a_ not in b_
+template<class SetA, class SetB, class Out>
+size_t hashed_difference(const SetA& a_, const SetB& b_, Out out_)
+{
+	size_t n = 0;
+	detail::probe_each(b_, a_.begin(), a_.end(), [&](const auto& key, bool found)
+	{
+		if (!found)
+		{
+			out_(key);
+			++n;
+		}
+	});
+	return n;
+}
+
+//every element of the larger set, then those of the smaller one it lacks
+template<class SetA, class SetB, class Out>
+size_t hashed_union(const SetA& a_, const SetB& b_, Out out_)
+{
+	if (a_.size() < b_.size())
+		return hashed_union(b_, a_, std::move(out_));
+	size_t n = a_.size();
+	for (const auto& key : a_)
+		out_(key);
+	return n + hashed_difference(b_, a_, std::ref(out_));
+}
+
+//elements of both a_ and b_, ordered by a_.key_comp()
+template<class SetA, class SetB, class Out>
+size_t merge_intersection(const SetA& a_, const SetB& b_, Out out_)
+{
+	auto comp = a_.key_comp();
+	auto i = a_.begin();
+	auto j = b_.begin();
+	size_t n = 0;
+	//steps in a row on either side, negative for b_
+	ptrdiff_t run = 0;
+	while (i != a_.end() && j != b_.end())
+	{
+		const auto& x = detail::key_at(i);
+		const auto& y = detail::key_at(j);
+		if (comp(x, y))
+		{
+			run = run > 0 ? run + 1 : 1;
+			if (run < ptrdiff_t(gallop_after))
+				++i;
+			else
+				i = detail::seek(a_, i, y);
+		}
+		else if (comp(y, x))
+		{
+			run = run < 0 ? run - 1 : -1;
+			if (-run < ptrdiff_t(gallop_after))
+				++j;
+			else
+				j = detail::seek(b_, j, x);
+		}
+		else
+		{
+			out_(x);
+			++n;
+			++i;
+			++j;
+			run = 0;
+		}
+	}
+	return n;
+}
+
+//elements of a_ not in b_, ordered by a_.key_comp()
+template<class SetA, class SetB, class Out>
+size_t merge_difference(const SetA& a_, const SetB& b_, Out out_)
+{
+	auto comp = a_.key_comp();
+	auto j = b_.begin();
+	size_t n = 0;
+	for (auto i = a_.begin(); i != a_.end(); ++i)
+	{
+		const auto& x = detail::key_at(i);
+		for (size_t run = 0; j != b_.end() && comp(detail::key_at(j), x); ++run)
+		{
+			if (run < gallop_after)
+				++j;
+			else
+				j = detail::seek(b_, j, x);
+		}
+		if (j == b_.end() || comp(x, detail::key_at(j)))
+		{
+			out_(x);
+			++n;
+		}
+	}
+	return n;
+}
+
+//elements of a_ or b_, ordered by a_.key_comp()
+template<class SetA, class SetB, class Out>
+size_t merge_union(const SetA& a_, const SetB& b_, Out out_)
+{
+	auto comp = a_.key_comp();
+	auto i = a_.begin();
+	auto j = b_.begin();
+	size_t n = 0;
+	while (i != a_.end() && j != b_.end())
+	{
+		const auto& x = detail::key_at(i);
+		const auto& y = detail::key_at(j);
+		if (comp(y, x))
+		{
+			out_(y);
+			++j;
+		}
+		else
+		{
+			out_(x);
+			j = comp(x, y) ? j : std::next(j);
+			++i;
+		}
+		++n;
+	}
+	for (; i != a_.end(); ++i, ++n)
+		out_(detail::key_at(i));
+	for (; j != b_.end(); ++j, ++n)
+		out_(detail::key_at(j));
+	return n;
+}
+
+//elements of both [a_, a_ + na_) and [b_, b_ + nb_)
+template<class T, class Out>
+size_t sorted_intersection(const T* a_, size_t na_, const T* b_, size_t nb_, Out out_)
+{
+	if (nb_ < na_)
+		return sorted_intersection(b_, nb_, a_, na_, std::move(out_));
+	const T* a_end = a_ + na_;
+	const T* b_end = b_ + nb_;
+	size_t n = 0;
+	if (nb_ / skew_ratio >= na_)
+	{
+		for (; a_ != a_end && b_ != b_end; ++a_)
+		{
+			b_ = detail::gallop(b_, b_end, *a_);
+			if (b_ != b_end && !(*a_ < *b_))
+			{
+				out_(*a_);
+				++n;
+			}
+		}
+		return n;
+	}
+	if constexpr (std::is_integral<T>::value && detail::block_match<T>::lanes != 0)
+	{
+		const size_t lanes = detail::block_match<T>::lanes;
+		while (a_end - a_ >= ptrdiff_t(lanes) && b_end - b_ >= ptrdiff_t(lanes))
+		{
+			auto mask = detail::block_match<T>::match(a_, b_);
+			n += __builtin_popcount(mask);
+			for (; mask != 0; mask &= mask - 1)
+				out_(a_[__builtin_ctz(mask)]);
+			//the block with the smaller last element holds no more matches
+			T a_last = a_[lanes - 1];
+			T b_last = b_[lanes - 1];
+			a_ += a_last <= b_last ? lanes : 0;
+			b_ += b_last <= a_last ? lanes : 0;
+		}
+	}
+	while (a_ != a_end && b_ != b_end)
+	{
+		if (*a_ < *b_)
+			++a_;
+		else if (*b_ < *a_)
+			++b_;
+		else
+		{
+			out_(*a_);
+			++n;
+			++a_;
+			++b_;
+		}
+	}
+	return n;
+}
+
+//elements of [a_, a_ + na_) not in [b_, b_ + nb_)
+template<class T, class Out>
+size_t sorted_difference(const T* a_, size_t na_, const T* b_, size_t nb_, Out out_)
+{
+	const T* a_end = a_ + na_;
+	const T* b_end = b_ + nb_;
+	bool skewed = nb_ / skew_ratio >= na_;
+	size_t n = 0;
+	for (; a_ != a_end; ++a_)
+	{
+		if (skewed)
+			b_ = detail::gallop(b_, b_end, *a_);
+		else
+			for (; b_ != b_end && *b_ < *a_; ++b_);
+		if (b_ == b_end || *a_ < *b_)
+		{
+			out_(*a_);
+			++n;
+		}
+	}
+	return n;
+}
+
+//elements of [a_, a_ + na_) or [b_, b_ + nb_)
+template<class T, class Out>
+size_t sorted_union(const T* a_, size_t na_, const T* b_, size_t nb_, Out out_)
+{
+	const T* a_end = a_ + na_;
+	const T* b_end = b_ + nb_;
+	size_t n = 0;
+	for (; a_ != a_end && b_ != b_end; ++n)
+	{
+		if (*b_ < *a_)
+			out_(*b_++);
+		else
+		{
+			b_ += !(*a_ < *b_);
+			out_(*a_++);
+		}
+	}
+	for (; a_ != a_end; ++n)
+		out_(*a_++);
+	for (; b_ != b_end; ++n)
+		out_(*b_++);
+	return n;
+}
+
+}
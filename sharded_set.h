@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "container_ops.h"
+#include "hash_functions.h"
+
+//a concurrent set made of independently locked shards of any single-threaded
+//set (hot_set, ht_chained, the std and google sets)
+//
+//a key goes to the shard selected by the high bits of its hash, mixed with
+//fmix64 first so that identity hashes spread too; the inner sets select their
+//slots from the low bits, so the two choices stay independent. every shard
+//sits on its own cache lines, so threads locking different shards don't
+//contend on the lines of each other's mutexes. with one shard this is the
+//plain set-behind-a-mutex baseline
+template<class Inner, class Hash = typename Inner::hasher>
+class sharded_set
+{
+public:
+	typedef container_ops::key_type_t<Inner> key_type;
+	typedef Inner inner_type;
+	typedef Hash hasher;
+
+private:
+	struct alignas(64) shard
+	{
+		std::mutex mutex;
+		Inner set;
+	};
+
+	std::unique_ptr<shard[]> mshards;
+	size_t mcount;
+	unsigned mshift;
+	Hash mhash;
+
+	shard& shard_for(const key_type& key_) const
+	{
+		auto h = hashing::fmix64(uint64_t(mhash(key_)));
+		return mshards[mshift == 64 ? 0 : size_t(h >> mshift)];
+	}
+
+public:
+	//shards_ is rounded up to a power of two. init_, if given, is called on
+	//every inner set before use, e.g. to set the empty key of a dense_hash_set
+	explicit sharded_set(size_t shards_ = 64, std::function<void(Inner&)> init_ = nullptr, Hash hash_ = Hash())
+		: mcount(1)
+		, mshift(64)
+		, mhash(std::move(hash_))
+	{
+		while (mcount < shards_)
+		{
+			mcount <<= 1;
+			--mshift;
+		}
+		mshards.reset(new shard[mcount]);
+		if (init_)
+		{
+			for (size_t i = 0; i < mcount; ++i)
+				init_(mshards[i].set);
+		}
+	}
+
+	sharded_set(const sharded_set&) = delete;
+	sharded_set& operator=(const sharded_set&) = delete;
+
+	//true if key_ was not in the set
+	template<class K>
+	bool insert(K&& key_)
+	{
+		auto& s = shard_for(key_);
+		std::lock_guard<std::mutex> lock(s.mutex);
+		return container_ops::insert(s.set, std::forward<K>(key_));
+	}
+
+	//true if key_ was in the set
+	bool erase(const key_type& key_)
+	{
+		auto& s = shard_for(key_);
+		std::lock_guard<std::mutex> lock(s.mutex);
+		return container_ops::erase(s.set, key_);
+	}
+
+	bool contains(const key_type& key_) const
+	{
+		auto& s = shard_for(key_);
+		std::lock_guard<std::mutex> lock(s.mutex);
+		return container_ops::contains(s.set, key_);
+	}
+
+	//locks the shards one after the other: exact only without concurrent writers
+	size_t size() const
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < mcount; ++i)
+		{
+			std::lock_guard<std::mutex> lock(mshards[i].mutex);
+			n += mshards[i].set.size();
+		}
+		return n;
+	}
+
+	size_t shards() const
+	{
+		return mcount;
+	}
+
+	//calls f_(inner) for every shard, holding its lock
+	template<class Func>
+	void for_each_shard(Func f_)
+	{
+		for (size_t i = 0; i < mcount; ++i)
+		{
+			std::lock_guard<std::mutex> lock(mshards[i].mutex);
+			f_(mshards[i].set);
+		}
+	}
+};
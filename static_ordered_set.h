@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "allocators.h"
+
+//immutable ordered sets built once from a range, laid out for the cache rather
+//than in sorted order. both answer lower_bound with a root-to-leaf walk of an
+//implicit binary search tree, with no pointers stored:
+//
+//eytzinger_set keeps the tree in breadth-first order, children of k at 2k and
+//2k + 1. the walk is branchless, and since the 16 great-great-grandchildren of
+//k are contiguous it prefetches them four levels ahead, so the cache misses of
+//consecutive levels overlap.
+//
+//veb_set keeps the tree in van Emde Boas order: the top half of the levels is
+//stored first, then every subtree hanging below it, each laid out the same way
+//recursively. a walk then touches O(log_B n) lines for any line size B, with no
+//tuning, at the price of a few table lookups per level.
+//
+//flat_set is the plain sorted array baseline of both. lookups return a pointer
+//to the element, nullptr if there is none.
+
+namespace static_ordered
+{
+
+namespace detail
+{
+
+//sorted, duplicates dropped
+template<class T, class Compare, class It>
+std::vector<T> sorted_unique(It first_, It last_, Compare comp_)
+{
+	std::vector<T> v(first_, last_);
+	if (!std::is_sorted(v.begin(), v.end(), comp_))
+		std::sort(v.begin(), v.end(), comp_);
+	v.erase(std::unique(v.begin(), v.end(), [&](const T& a, const T& b)
+	{
+		return !comp_(a, b) && !comp_(b, a);
+	}), v.end());
+	return v;
+}
+
+}
+
+}
+
+template<
+	class T,	//contained type
+	class Compare = std::less<T>	//strict weak ordering
+>
+class eytzinger_set
+{
+public:
+	typedef T value_type;
+	typedef Compare key_compare;
+
+private:
+	//slot 0 is unused so that the root is 1; the array starts on a cache line,
+	//which puts the 16 descendants four levels below k on one 64-byte line for
+	//4-byte keys
+	std::vector<T, cache_aligned_allocator<T>> mslots;
+	size_t msize;
+	Compare comp;
+
+	static constexpr size_t prefetch_stride = sizeof(T) >= 64 ? 1 : 64 / sizeof(T);
+
+	size_t fill(const std::vector<T>& sorted_, size_t i_, size_t k_)
+	{
+		if (k_ <= msize)
+		{
+			i_ = fill(sorted_, i_, 2 * k_);
+			mslots[k_] = sorted_[i_++];
+			i_ = fill(sorted_, i_, 2 * k_ + 1);
+		}
+		return i_;
+	}
+
+	template<class F>
+	void visit(size_t k_, F& f_) const
+	{
+		if (k_ <= msize)
+		{
+			visit(2 * k_, f_);
+			f_(mslots[k_]);
+			visit(2 * k_ + 1, f_);
+		}
+	}
+
+public:
+	explicit eytzinger_set(Compare comp_ = Compare())
+		: mslots(1)
+		, msize(0)
+		, comp(comp_)
+	{}
+
+	//builds the set from [first_, last_), sorting it if it is not sorted and
+	//dropping duplicates
+	template<class It>
+	eytzinger_set(It first_, It last_, Compare comp_ = Compare())
+		: msize(0)
+		, comp(comp_)
+	{
+		auto sorted = static_ordered::detail::sorted_unique<T>(first_, last_, comp);
+		msize = sorted.size();
+		mslots.resize(msize + 1);
+		fill(sorted, 0, 1);
+	}
+
+	size_t size() const
+	{
+		return msize;
+	}
+
+	bool empty() const
+	{
+		return msize == 0;
+	}
+
+	//the first element not less than key_, nullptr if there is none
+	template<class K>
+	const T* lower_bound(const K& key_) const
+	{
+		const T* base = mslots.data();
+		size_t k = 1;
+		while (k <= msize)
+		{
+			__builtin_prefetch(base + k * prefetch_stride);
+			k = 2 * k + comp(base[k], key_);
+		}
+		//the right turns since the last left one are the trailing ones of k
+		k >>= __builtin_ffsll(~k);
+		return k ? base + k : nullptr;
+	}
+
+	template<class K>
+	const T* find(const K& key_) const
+	{
+		auto p = lower_bound(key_);
+		return p && !comp(key_, *p) ? p : nullptr;
+	}
+
+	template<class K>
+	bool contains(const K& key_) const
+	{
+		return find(key_) != nullptr;
+	}
+
+	template<class K>
+	size_t count(const K& key_) const
+	{
+		return contains(key_);
+	}
+
+	//calls f_(element) for every element, in order
+	template<class F>
+	void for_each(F f_) const
+	{
+		visit(1, f_);
+	}
+};
+
+template<
+	class T,	//contained type
+	class Compare = std::less<T>	//strict weak ordering
+>
+class veb_set
+{
+public:
+	typedef T value_type;
+	typedef Compare key_compare;
+
+	enum : size_t { max_height = 64 };
+
+private:
+	//the complete tree of mheight levels, in van Emde Boas order. past the
+	//msize real elements it is padded with copies of the largest one, which
+	//never win a lower_bound against it: they all come after it in order
+	std::vector<T, cache_aligned_allocator<T>> mslots;
+	size_t msize;
+	unsigned mheight;
+	Compare comp;
+
+	//the layout, per depth d of a node: the node is the root of a bottom tree of
+	//the recursive split whose top tree is rooted at depth mtop_depth[d]. that
+	//top tree has mtop_size[d] nodes and each bottom tree mbottom_size[d]; the
+	//node's position is then
+	//  pos[mtop_depth[d]] + mtop_size[d] + (i & mtop_size[d]) * mbottom_size[d]
+	//with i its breadth-first index, whose low bits pick the bottom tree
+	size_t mtop_size[max_height];
+	size_t mbottom_size[max_height];
+	unsigned mtop_depth[max_height];
+
+	void split(unsigned depth_, unsigned height_)
+	{
+		if (height_ <= 1)
+			return;
+		unsigned top = height_ / 2;
+		unsigned bottom = height_ - top;
+		mtop_size[depth_ + top] = (size_t(1) << top) - 1;
+		mbottom_size[depth_ + top] = (size_t(1) << bottom) - 1;
+		mtop_depth[depth_ + top] = depth_;
+		split(depth_, top);
+		split(depth_ + top, bottom);
+	}
+
+	//the tree below breadth-first index i_, of height_ levels, from out_ on
+	size_t layout(size_t i_, unsigned height_, size_t out_, const std::vector<T>& sorted_)
+	{
+		if (height_ == 1)
+		{
+			//in-order rank of a node: its subtree size below, plus what precedes it
+			auto depth = 63 - __builtin_clzll(i_);
+			auto below = mheight - 1 - depth;
+			auto rank = ((i_ - (size_t(1) << depth)) << (below + 1)) + (size_t(1) << below) - 1;
+			mslots[out_] = sorted_[std::min(rank, msize - 1)];
+			return out_ + 1;
+		}
+		unsigned top = height_ / 2;
+		unsigned bottom = height_ - top;
+		out_ = layout(i_, top, out_, sorted_);
+		for (size_t j = 0; j < (size_t(1) << top); ++j)
+			out_ = layout((i_ << top) + j, bottom, out_, sorted_);
+		return out_;
+	}
+
+	size_t position(size_t i_, unsigned d_, const size_t* pos_) const
+	{
+		return d_ == 0 ? 0 : pos_[mtop_depth[d_]] + mtop_size[d_] + (i_ & mtop_size[d_]) * mbottom_size[d_];
+	}
+
+	template<class F>
+	void visit(size_t i_, unsigned d_, size_t* pos_, size_t& rank_, F& f_) const
+	{
+		if (d_ == mheight || rank_ == msize)
+			return;
+		pos_[d_] = position(i_, d_, pos_);
+		visit(2 * i_, d_ + 1, pos_, rank_, f_);
+		if (rank_ == msize)
+			return;
+		f_(mslots[pos_[d_]]);
+		++rank_;
+		visit(2 * i_ + 1, d_ + 1, pos_, rank_, f_);
+	}
+
+public:
+	explicit veb_set(Compare comp_ = Compare())
+		: msize(0)
+		, mheight(0)
+		, comp(comp_)
+	{}
+
+	//builds the set from [first_, last_), sorting it if it is not sorted and
+	//dropping duplicates
+	template<class It>
+	veb_set(It first_, It last_, Compare comp_ = Compare())
+		: msize(0)
+		, mheight(0)
+		, comp(comp_)
+	{
+		auto sorted = static_ordered::detail::sorted_unique<T>(first_, last_, comp);
+		msize = sorted.size();
+		while (((size_t(1) << mheight) - 1) < msize)
+			++mheight;
+		if (msize == 0)
+			return;
+		split(0, mheight);
+		mslots.resize((size_t(1) << mheight) - 1);
+		layout(1, mheight, 0, sorted);
+	}
+
+	size_t size() const
+	{
+		return msize;
+	}
+
+	bool empty() const
+	{
+		return msize == 0;
+	}
+
+	//the first element not less than key_, nullptr if there is none
+	template<class K>
+	const T* lower_bound(const K& key_) const
+	{
+		size_t pos[max_height];
+		const T* best = nullptr;
+		size_t i = 1;
+		for (unsigned d = 0; d < mheight; ++d)
+		{
+			pos[d] = position(i, d, pos);
+			const T* node = mslots.data() + pos[d];
+			bool right = comp(*node, key_);
+			best = right ? best : node;
+			i = 2 * i + right;
+		}
+		return best;
+	}
+
+	template<class K>
+	const T* find(const K& key_) const
+	{
+		auto p = lower_bound(key_);
+		return p && !comp(key_, *p) ? p : nullptr;
+	}
+
+	template<class K>
+	bool contains(const K& key_) const
+	{
+		return find(key_) != nullptr;
+	}
+
+	template<class K>
+	size_t count(const K& key_) const
+	{
+		return contains(key_);
+	}
+
+	//calls f_(element) for every element, in order
+	template<class F>
+	void for_each(F f_) const
+	{
+		size_t pos[max_height];
+		size_t rank = 0;
+		visit(1, 0, pos, rank, f_);
+	}
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//append-only storage for string keys
+//
+//characters are packed back to back into large blocks, so a set of
+//std::string_view pointing into the arena costs 16 bytes per slot plus the
+//characters, with no per-key heap allocation. blocks are never moved or
+//freed before clear() or destruction, so views stay valid for the arena's
+//lifetime. use e.g. hov_set<std::string_view> or ht_chained<std::string_view>
+//with std::hash<std::string_view>, which hash and compare the characters.
+class string_arena
+{
+	std::vector<std::unique_ptr<char[]>> mblocks;
+	char* mcurrent;
+	char* mend;
+	size_t mblock_size;
+	size_t mused;
+	size_t mreserved;
+
+	char* allocate_block(size_t size)
+	{
+		mblocks.emplace_back(new char[size]);
+		mreserved += size;
+		return mblocks.back().get();
+	}
+
+public:
+	explicit string_arena(size_t block_size_ = size_t(1) << 20)
+		: mcurrent(nullptr)
+		, mend(nullptr)
+		, mblock_size(block_size_ > 0 ? block_size_ : 1)
+		, mused(0)
+		, mreserved(0)
+	{}
+
+	string_arena(const string_arena&) = delete;
+	string_arena& operator=(const string_arena&) = delete;
+
+	string_arena(string_arena&& in)
+		: mblocks(std::move(in.mblocks))
+		, mcurrent(in.mcurrent)
+		, mend(in.mend)
+		, mblock_size(in.mblock_size)
+		, mused(in.mused)
+		, mreserved(in.mreserved)
+	{
+		in.mblocks.clear();
+		in.mcurrent = in.mend = nullptr;
+		in.mused = in.mreserved = 0;
+	}
+
+	string_arena& operator=(string_arena&& in)
+	{
+		std::swap(mblocks, in.mblocks);
+		std::swap(mcurrent, in.mcurrent);
+		std::swap(mend, in.mend);
+		std::swap(mblock_size, in.mblock_size);
+		std::swap(mused, in.mused);
+		std::swap(mreserved, in.mreserved);
+		return *this;
+	}
+
+	//copies str into the arena and returns a view of the copy
+	std::string_view intern(std::string_view str)
+	{
+		auto size = str.size();
+		if (size == 0)
+			return std::string_view();
+
+		char* dest;
+		if (size > size_t(mend - mcurrent))
+		{
+			//large strings get a block of their own so the current block isn't wasted
+			if (size > mblock_size / 4)
+			{
+				dest = allocate_block(size);
+				std::memcpy(dest, str.data(), size);
+				mused += size;
+				return std::string_view(dest, size);
+			}
+			mcurrent = allocate_block(mblock_size);
+			mend = mcurrent + mblock_size;
+		}
+
+		dest = mcurrent;
+		mcurrent += size;
+		std::memcpy(dest, str.data(), size);
+		mused += size;
+		return std::string_view(dest, size);
+	}
+
+	//releases every block; invalidates all views handed out
+	void clear()
+	{
+		mblocks.clear();
+		mcurrent = mend = nullptr;
+		mused = mreserved = 0;
+	}
+
+	//number of characters stored
+	size_t bytes_used() const
+	{
+		return mused;
+	}
+
+	//number of characters allocated from the heap
+	size_t bytes_reserved() const
+	{
+		return mreserved;
+	}
+};
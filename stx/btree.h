@@ -43,8 +43,13 @@
 #include <ostream>
 #include <memory>
 #include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
 #include <assert.h>
 
+#include "../instrumentation.h"
+
 // *** Debugging Macros
 
 #ifdef BTREE_DEBUG
@@ -108,6 +113,11 @@ struct btree_default_set_traits
     /// than this threshold. See notes at
     /// http://panthema.net/2013/0504-STX-B+Tree-Binary-vs-Linear-Search
     static const size_t binsearch_threshold = 256;
+
+    /// If true, inner nodes count the pairs below each child, which makes
+    /// rank(), count_range() and nth() O(log n) at the price of one size_t
+    /// per child and keeping the counts up to date on every change.
+    static const bool   order_statistics = false;
 };
 
 /** Generates default traits for a B+ tree used as a map. It estimates leaf and
@@ -138,6 +148,47 @@ struct btree_default_map_traits
     /// than this threshold. See notes at
     /// http://panthema.net/2013/0504-STX-B+Tree-Binary-vs-Linear-Search
     static const size_t binsearch_threshold = 256;
+
+    /// If true, inner nodes count the pairs below each child, which makes
+    /// rank(), count_range() and nth() O(log n) at the price of one size_t
+    /// per child and keeping the counts up to date on every change.
+    static const bool   order_statistics = false;
+};
+
+/// Maps any type to void, used to detect optional members of traits classes.
+template <typename _Type>
+struct btree_void
+{
+    typedef void type;
+};
+
+/** Selects the instrumentation policy of a B+ tree (see instrumentation.h):
+ * _Traits::instrumentation if the traits define it, no_instrumentation
+ * otherwise, so existing traits classes keep working. */
+template <typename _Traits, typename _Enable = void>
+struct btree_instrumentation_of
+{
+    typedef no_instrumentation type;
+};
+
+template <typename _Traits>
+struct btree_instrumentation_of<_Traits, typename btree_void<typename _Traits::instrumentation>::type>
+{
+    typedef typename _Traits::instrumentation type;
+};
+
+/** Whether a B+ tree keeps subtree counts in its inner nodes:
+ * _Traits::order_statistics if the traits define it, false otherwise. */
+template <typename _Traits, typename _Enable = void>
+struct btree_order_statistics_of
+{
+    static const bool value = false;
+};
+
+template <typename _Traits>
+struct btree_order_statistics_of<_Traits, typename btree_void<decltype(_Traits::order_statistics)>::type>
+{
+    static const bool value = _Traits::order_statistics;
 };
 
 /** @brief Basic class implementing a base B+ tree data structure in memory.
@@ -247,6 +298,16 @@ public:
     /// with BTREE_DEBUG and the key type must be std::ostream printable.
     static const bool                   debug = traits::debug;
 
+    /// Instrumentation policy counting node splits, merges, the leaf
+    /// rewrites of merge() and the nodes visited by find(). Taken from traits::instrumentation if present,
+    /// otherwise no_instrumentation which compiles away.
+    typedef typename btree_instrumentation_of<traits>::type instrumentation_type;
+
+    /// Order statistics option: inner nodes keep the number of pairs below
+    /// each child. Taken from traits::order_statistics if present, otherwise
+    /// false.
+    static const bool                   order_statistics = btree_order_statistics_of<traits>::value;
+
 private:
     // *** Node Classes for In-Memory Nodes
 
@@ -288,6 +349,9 @@ private:
         /// Pointers to children
         node*           childid[innerslotmax+1];
 
+        /// Number of key/data pairs below each child, if order_statistics
+        size_type       childcount[order_statistics ? innerslotmax+1 : 1];
+
         /// Set variables to initial values
         inline void initialize(const unsigned short l)
         {
@@ -674,6 +738,11 @@ public:
         /// data items directly
         friend class const_reverse_iterator;
 
+        /// Also friendly to the base btree class, because the hinted
+        /// lower_bound() continues from the currnode and currslot values.
+        friend class btree<key_type, data_type, value_type, key_compare,
+                           traits, allow_duplicates, allocator_type, used_as_set>;
+
         /// Evil! A temporary value_type to STL-correctly deliver operator* and
         /// operator->
         mutable value_type              temp_value;
@@ -1305,6 +1374,9 @@ private:
     /// Memory allocator.
     allocator_type m_allocator;
 
+    /// Instrumentation policy object, see instrumentation_type.
+    instrumentation_type m_instr;
+
 public:
     // *** Constructors and Destructor
 
@@ -1362,6 +1434,19 @@ public:
         std::swap(m_stats, from.m_stats);
         std::swap(m_key_less, from.m_key_less);
         std::swap(m_allocator, from.m_allocator);
+        std::swap(m_instr, from.m_instr);
+    }
+
+private:
+    /// Exchanges the nodes and item counts with other, but not the
+    /// comparator, allocator or instrumentation: join() and merge() move
+    /// the pairs between trees, which keep their own counters.
+    void swap_nodes(btree_self &other)
+    {
+        std::swap(m_root, other.m_root);
+        std::swap(m_headleaf, other.m_headleaf);
+        std::swap(m_tailleaf, other.m_tailleaf);
+        std::swap(m_stats, other.m_stats);
     }
 
 public:
@@ -1520,6 +1605,80 @@ private:
         else return std::copy_backward(first, last, result);
     }
 
+    // *** Subtree Counts of Inner Nodes, Maintained if order_statistics
+
+    /// Conditional copying of childcount, like data_copy() for slotdata. This
+    /// should be used wherever childid ranges are moved.
+    template<class InputIterator, class OutputIterator>
+    static OutputIterator count_copy (InputIterator first, InputIterator last,
+                                      OutputIterator result)
+    {
+        if (!order_statistics) return result; // no operation
+        else return std::copy(first, last, result);
+    }
+
+    /// Conditional copying of childcount, like data_copy_backward().
+    template<class InputIterator, class OutputIterator>
+    static OutputIterator count_copy_backward (InputIterator first, InputIterator last,
+                                               OutputIterator result)
+    {
+        if (!order_statistics) return result; // no operation
+        else return std::copy_backward(first, last, result);
+    }
+
+    /// Number of key/data pairs below n. Requires order_statistics for inner
+    /// nodes.
+    static size_type subtree_size(const node *n)
+    {
+        if (n->isleafnode()) return n->slotuse;
+
+        const inner_node *inner = static_cast<const inner_node*>(n);
+        return count_sum(inner, 0, inner->slotuse + 1);
+    }
+
+    /// Sum of the counts of the children of inner in slots [first,last).
+    static size_type count_sum(const inner_node *inner, unsigned short first, unsigned short last)
+    {
+        size_type sum = 0;
+        if (order_statistics) {
+            for (unsigned short slot = first; slot < last; ++slot)
+                sum += inner->childcount[slot];
+        }
+        return sum;
+    }
+
+    /// Recounts the children of inner in slots [first,last] from the
+    /// children themselves.
+    static void count_children(inner_node *inner, unsigned short first, unsigned short last)
+    {
+        if (!order_statistics) return;
+        for (unsigned short slot = first; slot <= last; ++slot)
+            inner->childcount[slot] = subtree_size(inner->childid[slot]);
+    }
+
+    /// Recounts all children of inner.
+    static void count_children(inner_node *inner)
+    {
+        count_children(inner, 0, inner->slotuse);
+    }
+
+    /// Adjusts the count of the child at slot by diff, +1 or -1 after a pair
+    /// was inserted or erased below it.
+    static void count_add(inner_node *inner, unsigned short slot, int diff)
+    {
+        if (!order_statistics) return;
+        inner->childcount[slot] += diff;
+    }
+
+    /// Moves num pairs from the count of the child at slot from to that of
+    /// the child at slot to, after pairs were shifted between siblings.
+    static void count_move(inner_node *inner, unsigned short from, unsigned short to, size_type num)
+    {
+        if (!order_statistics) return;
+        inner->childcount[from] -= num;
+        inner->childcount[to] += num;
+    }
+
 public:
     // *** Fast Destruction of the B+ Tree
 
@@ -1749,6 +1908,12 @@ public:
         return m_stats;
     }
 
+    /// Return the instrumentation policy object holding split/merge counts.
+    inline const instrumentation_type& instrumentation() const
+    {
+        return m_instr;
+    }
+
 public:
     // *** Standard Access Functions Querying the Tree by Descending to a Leaf
 
@@ -1780,16 +1945,20 @@ public:
         node *n = m_root;
         if (!n) return end();
 
+        size_t visited = 1;
         while(!n->isleafnode())
         {
             const inner_node *inner = static_cast<const inner_node*>(n);
             int slot = find_lower(inner, key);
 
             n = inner->childid[slot];
+            ++visited;
         }
 
         leaf_node *leaf = static_cast<leaf_node*>(n);
 
+        m_instr.probe_steps(visited);
+
         int slot = find_lower(leaf, key);
         return (slot < leaf->slotuse && key_equal(key, leaf->slotkey[slot]))
             ? iterator(leaf, slot) : end();
@@ -1802,16 +1971,20 @@ public:
         const node *n = m_root;
         if (!n) return end();
 
+        size_t visited = 1;
         while(!n->isleafnode())
         {
             const inner_node *inner = static_cast<const inner_node*>(n);
             int slot = find_lower(inner, key);
 
             n = inner->childid[slot];
+            ++visited;
         }
 
         const leaf_node *leaf = static_cast<const leaf_node*>(n);
 
+        m_instr.probe_steps(visited);
+
         int slot = find_lower(leaf, key);
         return (slot < leaf->slotuse && key_equal(key, leaf->slotkey[slot]))
             ? const_iterator(leaf, slot) : end();
@@ -1821,6 +1994,9 @@ public:
     /// identical key entries found.
     size_type count(const key_type &key) const
     {
+        if (order_statistics && allow_duplicates)
+            return rank_descend(key, true) - rank_descend(key, false);
+
         const node *n = m_root;
         if (!n) return 0;
 
@@ -1948,6 +2124,159 @@ public:
         return std::pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
     }
 
+private:
+    // *** Hinted Search
+
+    /// Number of leaves the hinted lower_bound() walks along the nextleaf
+    /// chain before it gives up and descends from the root.
+    static const int finger_leaves = 2;
+
+    /// Shared by both hinted lower_bound(): walks from the slot of leaf towards
+    /// key, looking only at the last key of the leaves it passes. False if key
+    /// lies beyond finger_leaves leaves.
+    template <typename leaf_type>
+    inline bool finger_search(leaf_type *&leaf, unsigned short &slot, const key_type& key) const
+    {
+        for (int i = 0; i < finger_leaves; ++i)
+        {
+            if (leaf->slotuse != 0 && !m_key_less(leaf->slotkey[leaf->slotuse - 1], key))
+            {
+                while (slot < leaf->slotuse && m_key_less(leaf->slotkey[slot], key)) ++slot;
+                return true;
+            }
+            if (leaf->nextleaf == NULL) {
+                slot = leaf->slotuse;
+                return true;
+            }
+            leaf = leaf->nextleaf;
+            slot = 0;
+        }
+        return false;
+    }
+
+public:
+    /// Searches the B+ tree forward from hint and returns an iterator to the
+    /// first pair equal to or greater than key, like lower_bound(key), if
+    /// hint is not past that pair, and hint otherwise. Keys in the leaf of
+    /// hint or the next one are found along the leaf chain without a descent
+    /// from the root, so merging another sorted sequence into a walk of the
+    /// tree costs a cache line or two per step instead of a root-to-leaf path.
+    iterator lower_bound(iterator hint, const key_type& key)
+    {
+        if (!hint.currnode) return lower_bound(key);
+
+        leaf_node *leaf = hint.currnode;
+        unsigned short slot = hint.currslot;
+
+        if (finger_search(leaf, slot, key))
+            return iterator(leaf, slot);
+        return lower_bound(key);
+    }
+
+    /// Searches the B+ tree forward from hint and returns a constant
+    /// iterator to the first pair equal to or greater than key, like
+    /// lower_bound(key), if hint is not past that pair, and hint otherwise.
+    const_iterator lower_bound(const_iterator hint, const key_type& key) const
+    {
+        if (!hint.currnode) return lower_bound(key);
+
+        const leaf_node *leaf = hint.currnode;
+        unsigned short slot = hint.currslot;
+
+        if (finger_search(leaf, slot, key))
+            return const_iterator(leaf, slot);
+        return lower_bound(key);
+    }
+
+public:
+    // *** Order Statistics, Requiring traits::order_statistics
+
+    /// Returns the number of pairs less than key, the position of
+    /// lower_bound(key), in O(log n).
+    size_type rank(const key_type &key) const
+    {
+        static_assert(order_statistics, "btree::rank() requires traits::order_statistics");
+        return rank_descend(key, false);
+    }
+
+    /// Returns the number of pairs not less than lo and less than hi in
+    /// O(log n), instead of walking them from lower_bound(lo).
+    size_type count_range(const key_type &lo, const key_type &hi) const
+    {
+        static_assert(order_statistics, "btree::count_range() requires traits::order_statistics");
+        if (!m_key_less(lo, hi)) return 0;
+        return rank_descend(hi, false) - rank_descend(lo, false);
+    }
+
+    /// Returns an iterator to the pair at position k in order, end() if k is
+    /// not less than size(), in O(log n).
+    iterator nth(size_type k)
+    {
+        static_assert(order_statistics, "btree::nth() requires traits::order_statistics");
+        if (k >= size()) return end();
+
+        node *n = m_root;
+        while (!n->isleafnode())
+        {
+            inner_node *inner = static_cast<inner_node*>(n);
+            unsigned short slot = nth_child(inner, k);
+            n = inner->childid[slot];
+        }
+
+        return iterator(static_cast<leaf_node*>(n), k);
+    }
+
+    /// Returns a constant iterator to the pair at position k in order, end()
+    /// if k is not less than size(), in O(log n).
+    const_iterator nth(size_type k) const
+    {
+        static_assert(order_statistics, "btree::nth() requires traits::order_statistics");
+        if (k >= size()) return end();
+
+        const node *n = m_root;
+        while (!n->isleafnode())
+        {
+            const inner_node *inner = static_cast<const inner_node*>(n);
+            unsigned short slot = nth_child(inner, k);
+            n = inner->childid[slot];
+        }
+
+        return const_iterator(static_cast<const leaf_node*>(n), k);
+    }
+
+private:
+    /// Returns the number of pairs before lower_bound(key), or before
+    /// upper_bound(key) if upper, summing the counts of the children left of
+    /// the path.
+    size_type rank_descend(const key_type &key, bool upper) const
+    {
+        const node *n = m_root;
+        if (!n) return 0;
+
+        size_type rank = 0;
+        while (!n->isleafnode())
+        {
+            const inner_node *inner = static_cast<const inner_node*>(n);
+            unsigned short slot = upper ? find_upper(inner, key) : find_lower(inner, key);
+
+            rank += count_sum(inner, 0, slot);
+            n = inner->childid[slot];
+        }
+
+        const leaf_node *leaf = static_cast<const leaf_node*>(n);
+        return rank + (upper ? find_upper(leaf, key) : find_lower(leaf, key));
+    }
+
+    /// Returns the child of inner holding the pair at position k below inner,
+    /// and makes k its position below that child.
+    static unsigned short nth_child(const inner_node *inner, size_type &k)
+    {
+        unsigned short slot = 0;
+        while (slot < inner->slotuse && k >= inner->childcount[slot])
+            k -= inner->childcount[slot++];
+        return slot;
+    }
+
 public:
     // *** B+ Tree Object Comparison Functions
 
@@ -2069,6 +2398,7 @@ private:
 
             newinner->slotuse = inner->slotuse;
             std::copy(inner->slotkey, inner->slotkey + inner->slotuse, newinner->slotkey);
+            count_copy(inner->childcount, inner->childcount + inner->slotuse+1, newinner->childcount);
 
             for (unsigned short slot = 0; slot <= inner->slotuse; ++slot)
             {
@@ -2161,6 +2491,7 @@ private:
             newroot->childid[1] = newchild;
 
             newroot->slotuse = 1;
+            count_children(newroot);
 
             m_root = newroot;
         }
@@ -2245,6 +2576,10 @@ private:
                         splitinner->childid[0] = newchild;
                         *splitkey = newkey;
 
+                        // the child that was split is now the last of inner
+                        count_children(inner, inner->slotuse, inner->slotuse);
+                        count_children(splitinner, 0, 0);
+
                         return r;
                     }
                     else if (slot >= inner->slotuse+1)
@@ -2265,10 +2600,18 @@ private:
                                    inner->slotkey + inner->slotuse+1);
                 std::copy_backward(inner->childid + slot, inner->childid + inner->slotuse+1,
                                    inner->childid + inner->slotuse+2);
+                count_copy_backward(inner->childcount + slot, inner->childcount + inner->slotuse+1,
+                                    inner->childcount + inner->slotuse+2);
 
                 inner->slotkey[slot] = newkey;
                 inner->childid[slot + 1] = newchild;
                 inner->slotuse++;
+
+                count_children(inner, slot, slot + 1);
+            }
+            else if (r.second)
+            {
+                count_add(inner, slot, +1);
             }
 
             return r;
@@ -2325,6 +2668,8 @@ private:
     {
         BTREE_ASSERT(leaf->isfull());
 
+        typename instrumentation_type::scope timer(m_instr, instr_event::split);
+
         unsigned int mid = (leaf->slotuse >> 1);
 
         BTREE_PRINT("btree::split_leaf_node on " << leaf);
@@ -2363,6 +2708,8 @@ private:
     {
         BTREE_ASSERT(inner->isfull());
 
+        typename instrumentation_type::scope timer(m_instr, instr_event::split);
+
         unsigned int mid = (inner->slotuse >> 1);
 
         BTREE_PRINT("btree::split_inner: mid " << mid << " addslot " << addslot);
@@ -2384,6 +2731,8 @@ private:
                   newinner->slotkey);
         std::copy(inner->childid + mid+1, inner->childid + inner->slotuse+1,
                   newinner->childid);
+        count_copy(inner->childcount + mid+1, inner->childcount + inner->slotuse+1,
+                   newinner->childcount);
 
         inner->slotuse = mid;
 
@@ -2436,6 +2785,14 @@ public:
 
         BTREE_ASSERT( it == iend && num_items == 0 );
 
+        bulk_load_inner(num_leaves);
+    }
+
+private:
+    /// Second half of bulk_load() and merge(): constructs the inner nodes
+    /// above the num_leaves leaves linked from m_headleaf.
+    void bulk_load_inner(size_t num_leaves)
+    {
         // if the btree is so small to fit into one leaf, then we're done.
         if (m_headleaf == m_tailleaf) {
             m_root = m_headleaf;
@@ -2471,6 +2828,7 @@ public:
                 leaf = leaf->nextleaf;
             }
             n->childid[n->slotuse] = leaf;
+            count_children(n);
 
             // track max key of any descendant.
             nextlevel[i].first = n;
@@ -2508,6 +2866,7 @@ public:
                     ++inner_index;
                 }
                 n->childid[n->slotuse] = nextlevel[inner_index].first;
+                count_children(n);
 
                 // reuse nextlevel array for parents, because we can overwrite
                 // slots we've already consumed.
@@ -2527,6 +2886,667 @@ public:
         if (selfverify) verify();
     }
 
+public:
+    // *** Merging, Joining and Splitting B+ Trees
+
+    /// Moves all pairs of other into this B+ tree, leaving other empty. The
+    /// keys of other must all be greater than those of this tree, or not
+    /// less if duplicates are allowed. The root of the shorter tree is hung
+    /// into the taller one at its level, which touches O(log n) nodes. Both
+    /// trees must use equal allocators.
+    void join(btree_self &other)
+    {
+        if (&other == this || other.m_root == NULL) return;
+
+        if (m_root == NULL) {
+            swap_nodes(other);
+            return;
+        }
+
+        BTREE_ASSERT(allow_duplicates
+                     ? key_lessequal(m_tailleaf->slotkey[m_tailleaf->slotuse-1], other.m_headleaf->slotkey[0])
+                     : key_less(m_tailleaf->slotkey[m_tailleaf->slotuse-1], other.m_headleaf->slotkey[0]));
+
+        key_type amax = m_tailleaf->slotkey[m_tailleaf->slotuse-1];
+
+        m_tailleaf->nextleaf = other.m_headleaf;
+        other.m_headleaf->prevleaf = m_tailleaf;
+
+        m_stats.itemcount += other.m_stats.itemcount;
+        m_stats.leaves += other.m_stats.leaves;
+        m_stats.innernodes += other.m_stats.innernodes;
+
+        node *b = other.m_root;
+        other.m_root = other.m_headleaf = other.m_tailleaf = NULL;
+        other.m_stats = tree_stats();
+
+        m_root = join_roots(m_root, amax, b);
+        find_end_leaves();
+
+        if (selfverify) verify();
+    }
+
+private:
+    /// Below this fraction of the size of the tree, merge() inserts the pairs
+    /// of the other tree one by one rather than rewrite all leaves.
+    static const size_t merge_insert_ratio = 8;
+
+public:
+    /// Moves the pairs of other into this B+ tree. As with std::set::merge(),
+    /// if duplicates are not allowed the pairs whose key is already present
+    /// stay in other. If the key ranges do not overlap the trees are joined
+    /// in O(log n), see join(). Otherwise both leaf chains are walked in
+    /// order into new, full leaves, the inner nodes are built above them as
+    /// bulk_load() does and the old nodes are freed, without a descent or a
+    /// split per key; unless other is small enough for inserting its pairs
+    /// to cost less. Both trees must use equal allocators.
+    void merge(btree_self &other)
+    {
+        if (&other == this || other.m_root == NULL) return;
+
+        if (m_root == NULL) {
+            swap_nodes(other);
+            return;
+        }
+
+        const key_type &thismax = m_tailleaf->slotkey[m_tailleaf->slotuse-1];
+        const key_type &othermax = other.m_tailleaf->slotkey[other.m_tailleaf->slotuse-1];
+
+        if (allow_duplicates ? !m_key_less(other.m_headleaf->slotkey[0], thismax)
+                             : m_key_less(thismax, other.m_headleaf->slotkey[0])) {
+            join(other);
+            return;
+        }
+        if (allow_duplicates ? !m_key_less(m_headleaf->slotkey[0], othermax)
+                             : m_key_less(othermax, m_headleaf->slotkey[0])) {
+            swap_nodes(other);
+            join(other);
+            return;
+        }
+
+        btree_self merged(m_key_less, m_allocator), rest(m_key_less, m_allocator);
+
+        if (other.size() * merge_insert_ratio < size())
+        {
+            // a small tree is cheaper to insert than to rewrite every leaf
+            for (leaf_node *b = other.m_headleaf; b; b = b->nextleaf)
+            {
+                for (unsigned short j = 0; j < b->slotuse; ++j)
+                {
+                    if (!insert_start(b->slotkey[j], b->slotdata[used_as_set ? 0 : j]).second)
+                        rest.bulk_append(b, j);
+                }
+            }
+
+            rest.bulk_finish();
+            other.clear();
+            other.swap_nodes(rest);
+            return;
+        }
+
+        typename instrumentation_type::scope timer(m_instr, instr_event::rebuild);
+
+        leaf_node *a = m_headleaf, *b = other.m_headleaf;
+        unsigned short i = 0, j = 0;
+
+        while (a && b)
+        {
+            if (m_key_less(b->slotkey[j], a->slotkey[i])) {
+                merged.bulk_append(b, j);
+                bulk_next(b, j);
+                continue;
+            }
+            if (!allow_duplicates && !m_key_less(a->slotkey[i], b->slotkey[j])) {
+                rest.bulk_append(b, j);
+                bulk_next(b, j);
+            }
+            merged.bulk_append(a, i);
+            bulk_next(a, i);
+        }
+        for (; a; bulk_next(a, i))
+            merged.bulk_append(a, i);
+        for (; b; bulk_next(b, j))
+            merged.bulk_append(b, j);
+
+        merged.bulk_finish();
+        rest.bulk_finish();
+
+        clear();
+        other.clear();
+        swap_nodes(merged);
+        other.swap_nodes(rest);
+    }
+
+    /// Moves the pairs whose key is not less than key, from lower_bound(key)
+    /// on, into right, which must be empty and use an equal allocator. The
+    /// path to key is cut in two, and the pieces on either side are joined
+    /// into the two trees as join() does, which touches O(log n) nodes. The
+    /// node counts are then recounted on one side, which is linear: O(n)
+    /// leaves are visited, or with order_statistics only the O(n/B) inner
+    /// nodes of the smaller side.
+    void split(const key_type &key, btree_self &right)
+    {
+        BTREE_ASSERT(&right != this && right.m_root == NULL);
+
+        if (m_root == NULL || &right == this) return;
+
+        piece_list lefts, rights;
+        cut(m_root, m_tailleaf->slotkey[m_tailleaf->slotuse-1], key, lefts, rights);
+
+        node *lroot = join_lefts(lefts);
+        node *rroot = join_rights(rights);
+
+        // nodes were allocated and freed on this tree's stats, which still
+        // count both trees. one side is recounted, an empty one or else the
+        // smaller if the root counts tell, and the other keeps the rest
+        bool count_left = !lroot || (rroot && order_statistics && subtree_size(lroot) < subtree_size(rroot));
+        node *counted_root = count_left ? lroot : rroot;
+        tree_stats counted;
+        if (counted_root) count_nodes(counted_root, counted);
+
+        tree_stats rest = m_stats;
+        rest.itemcount -= counted.itemcount;
+        rest.leaves -= counted.leaves;
+        rest.innernodes -= counted.innernodes;
+        m_stats = count_left ? counted : rest;
+        right.m_stats = count_left ? rest : counted;
+
+        m_root = lroot;
+        right.m_root = rroot;
+        find_end_leaves();
+        right.find_end_leaves();
+
+        if (selfverify) {
+            verify();
+            right.verify();
+        }
+    }
+
+private:
+    // *** Joining and Splitting Subtrees
+
+    /// Result of join_subtrees(): one subtree, or two of the same level if
+    /// the join overflowed a node, with the largest key of the left one.
+    struct join_result
+    {
+        node        *left;
+        node        *right;
+        key_type    sep;
+    };
+
+    /// Joins the subtrees a and b of the same level, whose keys are in order
+    /// and the largest key below a is amax. Either may underflow, as the root
+    /// of a tree or of a piece cut by split(): they are merged into a if they
+    /// fit in one node, and evenly redistributed otherwise, which leaves
+    /// neither one underflowing.
+    join_result join_siblings(node *a, const key_type &amax, node *b)
+    {
+        join_result r = { a, NULL, key_type() };
+
+        if (a->isleafnode())
+        {
+            leaf_node *la = static_cast<leaf_node*>(a);
+            leaf_node *lb = static_cast<leaf_node*>(b);
+            BTREE_ASSERT(la->nextleaf == lb);
+
+            unsigned int total = la->slotuse + lb->slotuse;
+
+            if (total <= leafslotmax)
+            {
+                std::copy(lb->slotkey, lb->slotkey + lb->slotuse, la->slotkey + la->slotuse);
+                data_copy(lb->slotdata, lb->slotdata + lb->slotuse, la->slotdata + la->slotuse);
+                la->slotuse = total;
+
+                la->nextleaf = lb->nextleaf;
+                if (la->nextleaf) la->nextleaf->prevleaf = la;
+
+                free_node(lb);
+                return r;
+            }
+
+            unsigned int left = total / 2;
+            if (la->slotuse > left)
+            {
+                unsigned int move = la->slotuse - left;
+                std::copy_backward(lb->slotkey, lb->slotkey + lb->slotuse, lb->slotkey + lb->slotuse + move);
+                data_copy_backward(lb->slotdata, lb->slotdata + lb->slotuse, lb->slotdata + lb->slotuse + move);
+                std::copy(la->slotkey + left, la->slotkey + la->slotuse, lb->slotkey);
+                data_copy(la->slotdata + left, la->slotdata + la->slotuse, lb->slotdata);
+            }
+            else
+            {
+                unsigned int move = left - la->slotuse;
+                std::copy(lb->slotkey, lb->slotkey + move, la->slotkey + la->slotuse);
+                data_copy(lb->slotdata, lb->slotdata + move, la->slotdata + la->slotuse);
+                std::copy(lb->slotkey + move, lb->slotkey + lb->slotuse, lb->slotkey);
+                data_copy(lb->slotdata + move, lb->slotdata + lb->slotuse, lb->slotdata);
+            }
+            la->slotuse = left;
+            lb->slotuse = total - left;
+
+            r.right = b;
+            r.sep = la->slotkey[left-1];
+            return r;
+        }
+
+        inner_node *ia = static_cast<inner_node*>(a);
+        inner_node *ib = static_cast<inner_node*>(b);
+
+        // keys of both, with amax between them
+        unsigned int total = ia->slotuse + 1 + ib->slotuse;
+
+        if (total <= innerslotmax)
+        {
+            ia->slotkey[ia->slotuse] = amax;
+            std::copy(ib->slotkey, ib->slotkey + ib->slotuse, ia->slotkey + ia->slotuse+1);
+            std::copy(ib->childid, ib->childid + ib->slotuse+1, ia->childid + ia->slotuse+1);
+            count_copy(ib->childcount, ib->childcount + ib->slotuse+1, ia->childcount + ia->slotuse+1);
+            ia->slotuse = total;
+
+            free_node(ib);
+            return r;
+        }
+
+        key_type keys[2 * innerslotmax + 1];
+        node *childs[2 * innerslotmax + 2];
+
+        std::copy(ia->slotkey, ia->slotkey + ia->slotuse, keys);
+        keys[ia->slotuse] = amax;
+        std::copy(ib->slotkey, ib->slotkey + ib->slotuse, keys + ia->slotuse+1);
+        std::copy(ia->childid, ia->childid + ia->slotuse+1, childs);
+        std::copy(ib->childid, ib->childid + ib->slotuse+1, childs + ia->slotuse+1);
+
+        return spread_inner(ia, ib, keys, childs, total);
+    }
+
+    /// Spreads total keys and total+1 children evenly over the inner nodes a
+    /// and b, the key between them moving up.
+    join_result spread_inner(inner_node *a, inner_node *b, const key_type *keys, node *const *childs, unsigned int total)
+    {
+        unsigned int left = (total - 1) / 2;
+
+        std::copy(keys, keys + left, a->slotkey);
+        std::copy(childs, childs + left+1, a->childid);
+        a->slotuse = left;
+
+        std::copy(keys + left+1, keys + total, b->slotkey);
+        std::copy(childs + left+1, childs + total+1, b->childid);
+        b->slotuse = total - 1 - left;
+
+        count_children(a);
+        count_children(b);
+
+        join_result r = { a, b, keys[left] };
+        return r;
+    }
+
+    /// Puts the result r of a join below inner in place of its child at
+    /// slot: r.left at slot and r.right, if any, right after it. Splits inner
+    /// if it has no room left.
+    join_result replace_child(inner_node *inner, unsigned short slot, const join_result &r)
+    {
+        inner->childid[slot] = r.left;
+
+        join_result out = { inner, NULL, key_type() };
+        if (r.right == NULL) {
+            count_children(inner, slot, slot);
+            return out;
+        }
+
+        if (!inner->isfull())
+        {
+            std::copy_backward(inner->slotkey + slot, inner->slotkey + inner->slotuse,
+                               inner->slotkey + inner->slotuse+1);
+            std::copy_backward(inner->childid + slot+1, inner->childid + inner->slotuse+1,
+                               inner->childid + inner->slotuse+2);
+            count_copy_backward(inner->childcount + slot+1, inner->childcount + inner->slotuse+1,
+                                inner->childcount + inner->slotuse+2);
+
+            inner->slotkey[slot] = r.sep;
+            inner->childid[slot+1] = r.right;
+            inner->slotuse++;
+            count_children(inner, slot, slot+1);
+            return out;
+        }
+
+        key_type keys[innerslotmax + 1];
+        node *childs[innerslotmax + 2];
+
+        std::copy(inner->slotkey, inner->slotkey + slot, keys);
+        keys[slot] = r.sep;
+        std::copy(inner->slotkey + slot, inner->slotkey + inner->slotuse, keys + slot+1);
+        std::copy(inner->childid, inner->childid + slot+1, childs);
+        childs[slot+1] = r.right;
+        std::copy(inner->childid + slot+1, inner->childid + inner->slotuse+1, childs + slot+2);
+
+        return spread_inner(inner, allocate_inner(inner->level), keys, childs, innerslotmax + 1);
+    }
+
+    /// Joins the subtrees a and b, whose keys are in order, the largest key
+    /// below a being amax: the lower one is joined with the node of its level
+    /// on the facing edge of the higher one, and a node that overflows on the
+    /// way up is split.
+    join_result join_subtrees(node *a, const key_type &amax, node *b)
+    {
+        if (a->level == b->level)
+            return join_siblings(a, amax, b);
+
+        if (a->level > b->level)
+        {
+            inner_node *ia = static_cast<inner_node*>(a);
+            return replace_child(ia, ia->slotuse, join_subtrees(ia->childid[ia->slotuse], amax, b));
+        }
+
+        inner_node *ib = static_cast<inner_node*>(b);
+        return replace_child(ib, 0, join_subtrees(a, amax, ib->childid[0]));
+    }
+
+    /// Joins the subtrees a and b into one, adding a root above them if
+    /// needed. Returns the root.
+    node* join_roots(node *a, const key_type &amax, node *b)
+    {
+        join_result r = join_subtrees(a, amax, b);
+        if (r.right == NULL) return r.left;
+
+        inner_node *root = allocate_inner(r.left->level + 1);
+        root->slotkey[0] = r.sep;
+        root->childid[0] = r.left;
+        root->childid[1] = r.right;
+        root->slotuse = 1;
+        count_children(root);
+        return root;
+    }
+
+    /// Subtrees cut off on one side of a path, with their largest key, from
+    /// the root down.
+    typedef std::vector< std::pair<node*, key_type> > piece_list;
+
+    /// Cuts the tree below n, whose largest key is nmax, along the path to
+    /// key: the subtrees holding the pairs before lower_bound(key) are added
+    /// to lefts, the others to rights. Inner nodes on the path keep their
+    /// children before it if there are two, the others are freed; the leaf
+    /// chain is broken at the cut.
+    void cut(node *n, key_type nmax, const key_type &key, piece_list &lefts, piece_list &rights)
+    {
+        while (!n->isleafnode())
+        {
+            inner_node *inner = static_cast<inner_node*>(n);
+            unsigned short slot = find_lower(inner, key);
+
+            node *child = inner->childid[slot];
+            key_type childmax = (slot < inner->slotuse) ? inner->slotkey[slot] : nmax;
+
+            // children after the path
+            unsigned short rightchildren = inner->slotuse - slot;
+            if (rightchildren >= 2)
+            {
+                inner_node *r = allocate_inner(inner->level);
+                r->slotuse = rightchildren - 1;
+                std::copy(inner->slotkey + slot+1, inner->slotkey + inner->slotuse, r->slotkey);
+                std::copy(inner->childid + slot+1, inner->childid + inner->slotuse+1, r->childid);
+                count_copy(inner->childcount + slot+1, inner->childcount + inner->slotuse+1, r->childcount);
+                rights.push_back(std::make_pair(static_cast<node*>(r), nmax));
+            }
+            else if (rightchildren == 1)
+            {
+                rights.push_back(std::make_pair(inner->childid[inner->slotuse], nmax));
+            }
+
+            // children before the path, kept in this node if there are two
+            if (slot >= 2)
+            {
+                inner->slotuse = slot - 1;
+                lefts.push_back(std::make_pair(n, inner->slotkey[slot-1]));
+            }
+            else
+            {
+                if (slot == 1)
+                    lefts.push_back(std::make_pair(inner->childid[0], inner->slotkey[0]));
+                free_node(inner);
+            }
+
+            n = child;
+            nmax = childmax;
+        }
+
+        leaf_node *leaf = static_cast<leaf_node*>(n);
+        unsigned short slot = find_lower(leaf, key);
+
+        if (slot == 0)
+        {
+            if (leaf->prevleaf) leaf->prevleaf->nextleaf = NULL;
+            leaf->prevleaf = NULL;
+            rights.push_back(std::make_pair(n, leaf->slotkey[leaf->slotuse-1]));
+        }
+        else if (slot == leaf->slotuse)
+        {
+            if (leaf->nextleaf) leaf->nextleaf->prevleaf = NULL;
+            leaf->nextleaf = NULL;
+            lefts.push_back(std::make_pair(n, leaf->slotkey[leaf->slotuse-1]));
+        }
+        else
+        {
+            leaf_node *newleaf = allocate_leaf();
+            newleaf->slotuse = leaf->slotuse - slot;
+            std::copy(leaf->slotkey + slot, leaf->slotkey + leaf->slotuse, newleaf->slotkey);
+            data_copy(leaf->slotdata + slot, leaf->slotdata + leaf->slotuse, newleaf->slotdata);
+
+            newleaf->nextleaf = leaf->nextleaf;
+            if (newleaf->nextleaf) newleaf->nextleaf->prevleaf = newleaf;
+            leaf->nextleaf = NULL;
+            leaf->slotuse = slot;
+
+            lefts.push_back(std::make_pair(n, leaf->slotkey[slot-1]));
+            rights.push_back(std::make_pair(static_cast<node*>(newleaf), newleaf->slotkey[newleaf->slotuse-1]));
+        }
+    }
+
+    /// Joins the pieces cut off left of a path, from the deepest up, each in
+    /// front of those joined so far. Returns the root, NULL if there are none.
+    node* join_lefts(const piece_list &lefts)
+    {
+        node *root = NULL;
+        for (size_t p = lefts.size(); p-- > 0; )
+            root = root ? join_roots(lefts[p].first, lefts[p].second, root) : lefts[p].first;
+        return root;
+    }
+
+    /// Joins the pieces cut off right of a path, from the deepest up, each
+    /// after those joined so far. Returns the root, NULL if there are none.
+    node* join_rights(const piece_list &rights)
+    {
+        node *root = NULL;
+        key_type rootmax;
+        for (size_t p = rights.size(); p-- > 0; )
+        {
+            root = root ? join_roots(root, rootmax, rights[p].first) : rights[p].first;
+            rootmax = rights[p].second;
+        }
+        return root;
+    }
+
+    /// Frees the subtree n. Returns the number of pairs it held.
+    size_type free_subtree(node *n)
+    {
+        size_type items = n->slotuse;
+
+        if (!n->isleafnode())
+        {
+            inner_node *inner = static_cast<inner_node*>(n);
+
+            items = 0;
+            for (unsigned short slot = 0; slot <= inner->slotuse; ++slot)
+                items += free_subtree(inner->childid[slot]);
+        }
+
+        free_node(n);
+        return items;
+    }
+
+    /// Erases the pairs from lower_bound(lo) to lower_bound(*hi), or to the
+    /// end if hi is NULL. The tree is cut along the paths to lo and *hi, the
+    /// subtrees between the two cuts are freed whole and the pieces outside
+    /// them joined again: O(log n) nodes are touched besides the freed ones,
+    /// and only those on the two paths are rebalanced. Returns the number of
+    /// pairs erased.
+    size_type erase_range(const key_type &lo, const key_type *hi)
+    {
+        if (m_root == NULL || (hi && !m_key_less(lo, *hi))) return 0;
+
+        piece_list lefts, middle, rights;
+        cut(m_root, m_tailleaf->slotkey[m_tailleaf->slotuse-1], lo, lefts, middle);
+        m_root = NULL;
+
+        if (hi && !middle.empty())
+        {
+            node *mroot = join_rights(middle);
+            key_type mmax = middle.front().second;
+            middle.clear();
+            cut(mroot, mmax, *hi, middle, rights);
+        }
+
+        size_type erased = 0;
+        for (size_t p = 0; p < middle.size(); ++p)
+            erased += free_subtree(middle[p].first);
+        m_stats.itemcount -= erased;
+
+        node *lroot = join_lefts(lefts);
+        node *rroot = join_rights(rights);
+
+        if (lroot && rroot)
+        {
+            node *n = lroot;
+            while (!n->isleafnode())
+                n = static_cast<inner_node*>(n)->childid[n->slotuse];
+            leaf_node *lefttail = static_cast<leaf_node*>(n);
+
+            n = rroot;
+            while (!n->isleafnode())
+                n = static_cast<inner_node*>(n)->childid[0];
+            leaf_node *righthead = static_cast<leaf_node*>(n);
+
+            lefttail->nextleaf = righthead;
+            righthead->prevleaf = lefttail;
+
+            m_root = join_roots(lroot, lefts.back().second, rroot);
+        }
+        else
+        {
+            m_root = lroot ? lroot : rroot;
+        }
+
+        find_end_leaves();
+
+        return erased;
+    }
+
+    /// Sets m_headleaf and m_tailleaf from the root, after join_roots().
+    void find_end_leaves()
+    {
+        m_headleaf = m_tailleaf = NULL;
+        if (m_root == NULL) return;
+
+        node *n = m_root;
+        while (!n->isleafnode())
+            n = static_cast<inner_node*>(n)->childid[0];
+        m_headleaf = static_cast<leaf_node*>(n);
+        m_headleaf->prevleaf = NULL;
+
+        n = m_root;
+        while (!n->isleafnode())
+        {
+            inner_node *inner = static_cast<inner_node*>(n);
+            n = inner->childid[inner->slotuse];
+        }
+        m_tailleaf = static_cast<leaf_node*>(n);
+        m_tailleaf->nextleaf = NULL;
+    }
+
+    /// Adds the items and nodes of the subtree n to stats. With
+    /// order_statistics the leaves are not visited, their parents' counts
+    /// give the items.
+    static void count_nodes(const node *n, tree_stats &stats)
+    {
+        if (n->isleafnode())
+        {
+            stats.leaves++;
+            stats.itemcount += n->slotuse;
+            return;
+        }
+
+        const inner_node *inner = static_cast<const inner_node*>(n);
+        stats.innernodes++;
+        if (order_statistics && inner->level == 1)
+        {
+            stats.leaves += inner->slotuse + 1;
+            stats.itemcount += subtree_size(inner);
+            return;
+        }
+        for (unsigned short slot = 0; slot <= inner->slotuse; ++slot)
+            count_nodes(inner->childid[slot], stats);
+    }
+
+    /// Appends the pair at slot of leaf src, which is about to be freed, to
+    /// the leaves being built by merge().
+    void bulk_append(leaf_node *src, unsigned short slot)
+    {
+        leaf_node *leaf = m_tailleaf;
+        if (leaf == NULL || leaf->isfull())
+        {
+            leaf_node *newleaf = allocate_leaf();
+            if (leaf) {
+                leaf->nextleaf = newleaf;
+                newleaf->prevleaf = leaf;
+            }
+            else {
+                m_headleaf = newleaf;
+            }
+            m_tailleaf = leaf = newleaf;
+        }
+
+        leaf->slotkey[leaf->slotuse] = std::move(src->slotkey[slot]);
+        data_copy(std::make_move_iterator(src->slotdata + slot), std::make_move_iterator(src->slotdata + slot+1),
+                  leaf->slotdata + leaf->slotuse);
+        leaf->slotuse++;
+        m_stats.itemcount++;
+    }
+
+    /// Advances slot of leaf to the next pair in the leaf chain, leaf
+    /// becoming NULL past the end.
+    static void bulk_next(leaf_node *&leaf, unsigned short &slot)
+    {
+        if (++slot == leaf->slotuse) {
+            leaf = leaf->nextleaf;
+            slot = 0;
+        }
+    }
+
+    /// Completes the leaves built by bulk_append(): evens out the last two
+    /// if the last one underflows, then builds the inner nodes above them.
+    void bulk_finish()
+    {
+        if (m_tailleaf == NULL) return;
+
+        leaf_node *last = m_tailleaf;
+        leaf_node *prev = last->prevleaf;
+
+        if (prev && last->isunderflow())
+        {
+            unsigned int total = prev->slotuse + last->slotuse;
+            unsigned int move = total / 2 - last->slotuse;
+
+            std::copy_backward(last->slotkey, last->slotkey + last->slotuse, last->slotkey + last->slotuse + move);
+            data_copy_backward(last->slotdata, last->slotdata + last->slotuse, last->slotdata + last->slotuse + move);
+            std::copy(prev->slotkey + prev->slotuse - move, prev->slotkey + prev->slotuse, last->slotkey);
+            data_copy(prev->slotdata + prev->slotuse - move, prev->slotdata + prev->slotuse, last->slotdata);
+
+            prev->slotuse -= move;
+            last->slotuse += move;
+        }
+
+        bulk_load_inner(m_stats.leaves);
+    }
+
 private:
     // *** Support Class Encapsulating Deletion Results
 
@@ -2649,14 +3669,55 @@ public:
         if (selfverify) verify();
     }
 
-#ifdef BTREE_TODO
-    /// Erase all key/data pairs in the range [first,last). This function is
-    /// currently not implemented by the B+ Tree.
-    void erase(iterator /* first */, iterator /* last */)
+    /// Erase all key/data pairs in the range [first,last). Whole leaves and
+    /// subtrees inside the range are freed without visiting their pairs, and
+    /// the tree is rebalanced once along the paths to first and last instead
+    /// of after every pair, see erase_range(). Expiring the oldest pairs of a
+    /// tree keyed by time is erase(begin(), lower_bound(cutoff)).
+    void erase(iterator first, iterator last)
     {
-        abort();
-    }
+        if (first == last) return;
+
+        BTREE_PRINT("btree::erase_range on btree size " << size());
+
+        if (selfverify) verify();
+
+        if (first == begin() && last == end()) {
+            clear();
+            return;
+        }
+
+        // the range is erased by keys; with duplicates, the pairs with the
+        // key of first before it are put back, and those with the key of
+        // last before it, which the keys leave in, are erased one by one
+        std::vector<pair_type> before;
+        size_type lastdups = 0;
+
+        key_type lo = first.key();
+        key_type hi = (last == end()) ? key_type() : last.key();
+
+        if (allow_duplicates)
+        {
+            for (iterator it = lower_bound(lo); it != first; ++it)
+                before.push_back(pair_type(it.key(), it.data()));
+            if (last != end()) {
+                for (iterator it = lower_bound(hi); it != last; ++it)
+                    ++lastdups;
+            }
+        }
+
+        erase_range(lo, (last == end()) ? NULL : &hi);
+
+        for (; lastdups > 0; --lastdups)
+            erase_one(hi);
+        for (size_t i = before.size(); i-- > 0; )
+            insert_start(before[i].first, before[i].second);
+
+#ifdef BTREE_DEBUG
+        if (debug) print(std::cout);
 #endif
+        if (selfverify) verify();
+    }
 
 private:
     // *** Private Erase Functions
@@ -2838,6 +3899,8 @@ private:
                 return result;
             }
 
+            count_add(inner, slot, -1);
+
             if (result.has(btree_update_lastkey))
             {
                 if (parent && parentslot < parent->slotuse)
@@ -2865,10 +3928,15 @@ private:
 
                 free_node(inner->childid[slot]);
 
+                // its pairs moved into the child before it
+                count_move(inner, slot, slot-1, count_sum(inner, slot, slot+1));
+
                 std::copy(inner->slotkey + slot, inner->slotkey + inner->slotuse,
                           inner->slotkey + slot-1);
                 std::copy(inner->childid + slot+1, inner->childid + inner->slotuse+1,
                           inner->childid + slot);
+                count_copy(inner->childcount + slot+1, inner->childcount + inner->slotuse+1,
+                           inner->childcount + slot);
 
                 inner->slotuse--;
 
@@ -3147,6 +4215,8 @@ private:
             if (slot > inner->slotuse)
                 return btree_not_found;
 
+            count_add(inner, slot, -1);
+
             result_t myres = btree_ok;
 
             if (result.has(btree_update_lastkey))
@@ -3176,10 +4246,15 @@ private:
 
                 free_node(inner->childid[slot]);
 
+                // its pairs moved into the child before it
+                count_move(inner, slot, slot-1, count_sum(inner, slot, slot+1));
+
                 std::copy(inner->slotkey + slot, inner->slotkey + inner->slotuse,
                           inner->slotkey + slot-1);
                 std::copy(inner->childid + slot+1, inner->childid + inner->slotuse+1,
                           inner->childid + slot);
+                count_copy(inner->childcount + slot+1, inner->childcount + inner->slotuse+1,
+                           inner->childcount + slot);
 
                 inner->slotuse--;
 
@@ -3264,6 +4339,8 @@ private:
         BTREE_PRINT("Merge leaf nodes " << left << " and " << right << " with common parent " << parent << ".");
         (void)parent;
 
+        typename instrumentation_type::scope timer(m_instr, instr_event::merge);
+
         BTREE_ASSERT(left->isleafnode() && right->isleafnode());
         BTREE_ASSERT(parent->level == 1);
 
@@ -3290,10 +4367,12 @@ private:
     /// Merge two inner nodes. The function moves all key/childid pairs from
     /// right to left and sets right's slotuse to zero. The right slot is then
     /// removed by the calling parent node.
-    static result_t merge_inner(inner_node* left, inner_node* right, inner_node* parent, unsigned int parentslot)
+    result_t merge_inner(inner_node* left, inner_node* right, inner_node* parent, unsigned int parentslot)
     {
         BTREE_PRINT("Merge inner nodes " << left << " and " << right << " with common parent " << parent << ".");
 
+        typename instrumentation_type::scope timer(m_instr, instr_event::merge);
+
         BTREE_ASSERT(left->level == right->level);
         BTREE_ASSERT(parent->level == left->level + 1);
 
@@ -3324,6 +4403,8 @@ private:
                   left->slotkey + left->slotuse);
         std::copy(right->childid, right->childid + right->slotuse+1,
                   left->childid + left->slotuse);
+        count_copy(right->childcount, right->childcount + right->slotuse+1,
+                   left->childcount + left->slotuse);
 
         left->slotuse += right->slotuse;
         right->slotuse = 0;
@@ -3369,6 +4450,8 @@ private:
 
         right->slotuse -= shiftnum;
 
+        count_move(parent, parentslot+1, parentslot, shiftnum);
+
         // fixup parent
         if (parentslot < parent->slotuse) {
             parent->slotkey[parentslot] = left->slotkey[left->slotuse - 1];
@@ -3421,6 +4504,9 @@ private:
                   left->slotkey + left->slotuse);
         std::copy(right->childid, right->childid + shiftnum,
                   left->childid + left->slotuse);
+        count_copy(right->childcount, right->childcount + shiftnum,
+                   left->childcount + left->slotuse);
+        count_move(parent, parentslot+1, parentslot, count_sum(right, 0, shiftnum));
 
         left->slotuse += shiftnum - 1;
 
@@ -3433,6 +4519,8 @@ private:
                   right->slotkey);
         std::copy(right->childid + shiftnum, right->childid + right->slotuse+1,
                   right->childid);
+        count_copy(right->childcount + shiftnum, right->childcount + right->slotuse+1,
+                   right->childcount);
 
         right->slotuse -= shiftnum;
     }
@@ -3488,6 +4576,8 @@ private:
 
         left->slotuse -= shiftnum;
 
+        count_move(parent, parentslot, parentslot+1, shiftnum);
+
         parent->slotkey[parentslot] = left->slotkey[left->slotuse-1];
     }
 
@@ -3528,6 +4618,8 @@ private:
                            right->slotkey + right->slotuse + shiftnum);
         std::copy_backward(right->childid, right->childid + right->slotuse+1,
                            right->childid + right->slotuse+1 + shiftnum);
+        count_copy_backward(right->childcount, right->childcount + right->slotuse+1,
+                            right->childcount + right->slotuse+1 + shiftnum);
 
         right->slotuse += shiftnum;
 
@@ -3539,6 +4631,9 @@ private:
                   right->slotkey);
         std::copy(left->childid + left->slotuse - shiftnum+1, left->childid + left->slotuse+1,
                   right->childid);
+        count_copy(left->childcount + left->slotuse - shiftnum+1, left->childcount + left->slotuse+1,
+                   right->childcount);
+        count_move(parent, parentslot, parentslot+1, count_sum(left, left->slotuse - shiftnum+1, left->slotuse+1));
 
         // copy the first to-be-removed key from the left node to the parent's decision slot
         parent->slotkey[parentslot] = left->slotkey[left->slotuse - shiftnum];
@@ -3688,9 +4783,15 @@ private:
                 key_type subminkey = key_type();
                 key_type submaxkey = key_type();
 
+                size_type subitems = vstats.itemcount;
+
                 assert(subnode->level + 1 == inner->level);
                 verify_node(subnode, &subminkey, &submaxkey, vstats);
 
+                if (order_statistics)
+                    assert(inner->childcount[slot] == vstats.itemcount - subitems);
+                (void)subitems;
+
                 BTREE_PRINT("verify subnode " << subnode << ": " << subminkey << " - " << submaxkey);
 
                 if (slot == 0)
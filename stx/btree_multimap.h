@@ -140,6 +140,10 @@ public:
     /// Operational parameter: Allow duplicate keys in the btree.
     static const bool                   allow_duplicates = btree_impl::allow_duplicates;
 
+    /// Order statistics option: inner nodes count the pairs below each
+    /// child, see rank(), count_range() and nth().
+    static const bool                   order_statistics = btree_impl::order_statistics;
+
 public:
     // *** Iterators and Reverse Iterators
 
@@ -330,6 +334,12 @@ public:
         return tree.get_stats();
     }
 
+    /// Return the instrumentation policy object holding split/merge counts.
+    inline const typename btree_impl::instrumentation_type& instrumentation() const
+    {
+        return tree.instrumentation();
+    }
+
 public:
     // *** Standard Access Functions Querying the Tree by Descending to a Leaf
 
@@ -376,6 +386,23 @@ public:
         return tree.lower_bound(key);
     }
 
+    /// Searches the B+ tree forward from hint and returns an iterator to the
+    /// first pair equal to or greater than key, like lower_bound(key), if
+    /// hint is not past that pair. Keys in the leaf of hint or the next one
+    /// are found along the leaf chain, without a descent from the root.
+    iterator lower_bound(iterator hint, const key_type& key)
+    {
+        return tree.lower_bound(hint, key);
+    }
+
+    /// Searches the B+ tree forward from hint and returns a constant
+    /// iterator to the first pair equal to or greater than key, like
+    /// lower_bound(key), if hint is not past that pair.
+    const_iterator lower_bound(const_iterator hint, const key_type& key) const
+    {
+        return tree.lower_bound(hint, key);
+    }
+
     /// Searches the B+ tree and returns an iterator to the first pair
     /// greater than key, or end() if all keys are smaller or equal.
     iterator upper_bound(const key_type& key)
@@ -403,6 +430,36 @@ public:
         return tree.equal_range(key);
     }
 
+public:
+    // *** Order Statistics, Requiring traits::order_statistics
+
+    /// Returns the number of key/data pairs less than key in O(log n).
+    size_type rank(const key_type &key) const
+    {
+        return tree.rank(key);
+    }
+
+    /// Returns the number of key/data pairs not less than lo and less than hi in
+    /// O(log n).
+    size_type count_range(const key_type &lo, const key_type &hi) const
+    {
+        return tree.count_range(lo, hi);
+    }
+
+    /// Returns an iterator to the pair at position k in order, end() if k
+    /// is not less than size(), in O(log n).
+    iterator nth(size_type k)
+    {
+        return tree.nth(k);
+    }
+
+    /// Returns a constant iterator to the pair at position k in order, end()
+    /// if k is not less than size(), in O(log n).
+    const_iterator nth(size_type k) const
+    {
+        return tree.nth(k);
+    }
+
 public:
     // *** B+ Tree Object Comparison Functions
 
@@ -523,6 +580,33 @@ public:
         return tree.bulk_load(first, last);
     }
 
+public:
+    // *** Merging, Joining and Splitting
+
+    /// Moves the pairs of other into this multimap. Where the key ranges do
+    /// not overlap the trees are joined in O(log n), otherwise both are
+    /// walked in order into new leaves without an insert per key.
+    void merge(self &other)
+    {
+        tree.merge(other.tree);
+    }
+
+    /// Moves all pairs of other, whose keys must not be less than those of
+    /// this multimap, to its end in O(log n), leaving other empty.
+    void join(self &other)
+    {
+        tree.join(other.tree);
+    }
+
+    /// Moves the pairs whose key is not less than key into right, which must
+    /// be empty. The tree is cut along the path to key in O(log n), but
+    /// recounting the nodes of one side is linear: O(n), or O(n/B) with
+    /// order_statistics.
+    void split(const key_type &key, self &right)
+    {
+        tree.split(key, right.tree);
+    }
+
 public:
     // *** Public Erase Functions
 
@@ -546,14 +630,13 @@ public:
         return tree.erase(iter);
     }
 
-#ifdef BTREE_TODO
-    /// Erase all key/data pairs in the range [first,last). This function is
-    /// currently not implemented by the B+ Tree.
-    void erase(iterator /* first */, iterator /* last */)
+    /// Erase all key/data pairs in the range [first,last). Whole leaves and subtrees
+    /// inside the range are freed at once and the tree is rebalanced along
+    /// the paths to first and last only.
+    void erase(iterator first, iterator last)
     {
-        abort();
+        return tree.erase(first, last);
     }
-#endif
 
 #ifdef BTREE_DEBUG
 public:
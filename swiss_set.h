@@ -0,0 +1,503 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hash_functions.h"
+#include "hot_set.h"
+
+//group probing stays short up to 7/8 load
+struct swiss_load_policy : default_load_policy
+{
+	size_t occupancy(size_t allocated)
+	{
+		return allocated - allocated / 8;
+	}
+
+	size_t allocated(size_t occupied)
+	{
+		if (occupied == 0)
+			return 0;
+		size_t n = 32;
+		while (occupancy(n) < occupied)
+			n <<= 1;
+		return n;
+	}
+};
+
+//open addressing over groups of 16 slots, in the layout of Abseil's swiss
+//tables: one control byte per slot holds either 7 bits of the hash of its
+//element or a marker for a free (empty) or erased (deleted) slot. a lookup
+//compares the 7 bits against the 16 control bytes of a group at once (SSE2
+//cmpeq + movemask), touches keys only where they match, and stops at the
+//first group with an empty slot. groups are visited in triangular order
+//(+1, +2, +3... groups), which covers a power-of-two table.
+//
+//the template parameters are those of cuckoo_set; Load selects the first
+//group and decides when to grow, counting in slots
+template<
+	class T,	//contained type
+	class Equal = std::equal_to<void>,//element comparator
+	class Alloc = std::allocator<T>, //allocator
+	class Hash = std::hash<T>,	//hasher
+	class Load = swiss_load_policy,//growth and group selection, see default_load_policy
+	class Instr = no_instrumentation//counts rehashes and probe steps, see instrumentation.h
+>
+class swiss_set
+{
+public:
+	typedef T value_type;
+	typedef Hash hasher;
+	typedef Equal key_equal;
+	typedef Load load_policy_type;
+	typedef Alloc allocator_type;
+	typedef Instr instrumentation_type;
+
+	enum : size_t { group_slots = 16 };
+
+private:
+	//full slots have the sign bit clear, so the free ones are the movemask of the group
+	enum : int8_t { ctrl_empty = int8_t(0x80), ctrl_deleted = int8_t(0xfe) };
+
+	struct alignas(16) group
+	{
+		int8_t ctrl[group_slots];
+
+		//bit i set if slot i has control byte c_
+		unsigned match(int8_t c_) const
+		{
+#ifdef __SSE2__
+			auto v = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+			return unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c_))));
+#else
+			unsigned bits = 0;
+			for (size_t i = 0; i < group_slots; ++i)
+				bits |= unsigned(ctrl[i] == c_) << i;
+			return bits;
+#endif
+		}
+
+		//bit i set if slot i is empty or deleted
+		unsigned match_free() const
+		{
+#ifdef __SSE2__
+			return unsigned(_mm_movemask_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(ctrl))));
+#else
+			unsigned bits = 0;
+			for (size_t i = 0; i < group_slots; ++i)
+				bits |= unsigned(ctrl[i] < 0) << i;
+			return bits;
+#endif
+		}
+	};
+
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<group> group_allocator;
+
+	group* mgroups;
+	group* mgroups_end;
+	T* mslots;
+	size_t mcapacity;
+	size_t moccupied;
+	size_t mdeleted;
+	Hash hash;
+	Load load_alg;
+	Equal eq;
+	Alloc allocator;
+	Instr instr;
+
+	size_t group_count() const
+	{
+		return mgroups_end - mgroups;
+	}
+
+	T* slot(const group* g_, size_t i_) const
+	{
+		return mslots + (g_ - mgroups) * group_slots + i_;
+	}
+
+	//first group of the probe sequence, from the high bits of the mixed hash,
+	//and the 7 low bits stored in the control byte
+	std::pair<size_t, int8_t> locate(const T& value_) const
+	{
+		auto m = hashing::fmix64(uint64_t(hash(value_)));
+		auto g = load_alg.select(mgroups, mgroups_end, size_t(m >> 7));
+		return { size_t(g - mgroups), int8_t(m & 0x7f) };
+	}
+
+	T* find_slot(const T& value_) const
+	{
+		if (mgroups == mgroups_end)
+		{
+			return nullptr;
+		}
+		auto l = locate(value_);
+		auto mask = group_count() - 1;
+		auto index = l.first;
+		size_t steps = 0;
+		for (size_t step = 1; step <= group_count(); ++step)
+		{
+			auto& g = mgroups[index];
+			unsigned bits = g.match(l.second);
+			while (bits)
+			{
+				unsigned i = __builtin_ctz(bits);
+				bits &= bits - 1;
+				++steps;
+				auto s = slot(&g, i);
+				if (eq(value_, *s))
+				{
+					instr.probe_steps(steps);
+					return s;
+				}
+			}
+			if (g.match(ctrl_empty))
+			{
+				break;
+			}
+			index = (index + step) & mask;
+		}
+		instr.probe_steps(steps);
+		return nullptr;
+	}
+
+	void init(size_t slots_)
+	{
+		if (slots_ > 0)
+		{
+			group_allocator ga(allocator);
+			auto n = slots_ / group_slots;
+			mgroups = ga.allocate(n);
+			mgroups_end = mgroups + n;
+			std::memset(static_cast<void*>(mgroups), ctrl_empty, n * sizeof(group));
+			try
+			{
+				mslots = allocator.allocate(slots_);
+			}
+			catch (...)
+			{
+				ga.deallocate(mgroups, n);
+				mgroups = mgroups_end = nullptr;
+				throw;
+			}
+			mcapacity = load_alg.occupancy(slots_);
+		}
+	}
+
+	void release()
+	{
+		if (mgroups == mgroups_end)
+		{
+			return;
+		}
+		for (auto g = mgroups; g != mgroups_end; ++g)
+		{
+			for (unsigned full = ~g->match_free() & 0xffffu; full; full &= full - 1)
+			{
+				slot(g, __builtin_ctz(full))->~T();
+			}
+		}
+		group_allocator ga(allocator);
+		allocator.deallocate(mslots, allocated());
+		ga.deallocate(mgroups, group_count());
+		mgroups = mgroups_end = nullptr;
+		mslots = nullptr;
+		mcapacity = moccupied = mdeleted = 0;
+	}
+
+	void reallocate(size_t newslots_)
+	{
+		typename Instr::scope timer(instr, instr_event::rehash);
+		swiss_set other(hash, eq, load_alg, allocator);
+		other.init(newslots_);
+		for (auto g = mgroups; g != mgroups_end; ++g)
+		{
+			for (unsigned full = ~g->match_free() & 0xffffu; full; full &= full - 1)
+			{
+				other.insert_unique(std::move(*slot(g, __builtin_ctz(full))));
+			}
+		}
+		swap(other);
+	}
+
+	//precondition: value_ is not in the set
+	template<class U>
+	T* insert_unique(U&& value_)
+	{
+		if (moccupied + mdeleted >= mcapacity)
+		{
+			//mostly deleted slots: rebuilding at the same size is enough
+			auto slots = allocated();
+			reallocate(moccupied >= mcapacity / 2 || slots == 0 ? load_alg.grow(slots) : slots);
+		}
+		auto l = locate(value_);
+		auto mask = group_count() - 1;
+		auto index = l.first;
+		for (size_t step = 1; ; ++step)
+		{
+			auto& g = mgroups[index];
+			unsigned bits = g.match_free();
+			if (bits)
+			{
+				unsigned i = __builtin_ctz(bits);
+				auto s = slot(&g, i);
+				::new (static_cast<void*>(s)) T(std::forward<U>(value_));
+				mdeleted -= size_t(g.ctrl[i] == ctrl_deleted);
+				g.ctrl[i] = l.second;
+				++moccupied;
+				return s;
+			}
+			index = (index + step) & mask;
+		}
+	}
+
+	swiss_set(const Hash& hash_, const Equal& equal_, const Load& load_, const Alloc& alloc_)
+		: mgroups(nullptr)
+		, mgroups_end(nullptr)
+		, mslots(nullptr)
+		, mcapacity(0)
+		, moccupied(0)
+		, mdeleted(0)
+		, hash(hash_)
+		, load_alg(load_)
+		, eq(equal_)
+		, allocator(alloc_)
+	{}
+
+public:
+	struct iterator
+	{
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		const swiss_set* set;
+		size_t index;
+
+		iterator(const swiss_set* set_, size_t index_)
+			: set(set_)
+			, index(index_)
+		{
+			advance();
+		}
+
+		void advance()
+		{
+			auto n = set->allocated();
+			while (index != n && set->mgroups[index / group_slots].ctrl[index % group_slots] < 0)
+			{
+				++index;
+			}
+		}
+
+		const T& operator*() const
+		{
+			return set->mslots[index];
+		}
+
+		const T* operator->() const
+		{
+			return set->mslots + index;
+		}
+
+		iterator& operator++()
+		{
+			++index;
+			advance();
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator r(*this);
+			++*this;
+			return r;
+		}
+
+		bool operator==(const iterator& other) const
+		{
+			return index == other.index;
+		}
+
+		bool operator!=(const iterator& other) const
+		{
+			return index != other.index;
+		}
+	};
+
+	swiss_set()
+		: swiss_set(Hash(), Equal(), Load(), Alloc())
+	{}
+
+	explicit swiss_set(size_t capacity_, Hash hash_ = Hash(), Equal equal_ = Equal(), Load load_ = Load(), Alloc alloc_ = Alloc())
+		: swiss_set(hash_, equal_, load_, alloc_)
+	{
+		init(load_alg.allocated(capacity_));
+	}
+
+	swiss_set(const swiss_set& in)
+		: swiss_set(in.hash, in.eq, in.load_alg, in.allocator)
+	{
+		init(in.allocated());
+		for (auto g = in.mgroups; g != in.mgroups_end; ++g)
+		{
+			auto target = mgroups + (g - in.mgroups);
+			for (unsigned full = ~g->match_free() & 0xffffu; full; full &= full - 1)
+			{
+				auto i = __builtin_ctz(full);
+				::new (static_cast<void*>(slot(target, i))) T(*in.slot(g, i));
+			}
+			*target = *g;
+		}
+		moccupied = in.moccupied;
+		mdeleted = in.mdeleted;
+	}
+
+	swiss_set(swiss_set&& in)
+		: swiss_set(in.hash, in.eq, in.load_alg, in.allocator)
+	{
+		swap(in);
+	}
+
+	swiss_set& operator=(swiss_set other_)
+	{
+		swap(other_);
+		return *this;
+	}
+
+	~swiss_set()
+	{
+		release();
+	}
+
+	void swap(swiss_set& other_)
+	{
+		using std::swap;
+		swap(mgroups, other_.mgroups);
+		swap(mgroups_end, other_.mgroups_end);
+		swap(mslots, other_.mslots);
+		swap(mcapacity, other_.mcapacity);
+		swap(moccupied, other_.moccupied);
+		swap(mdeleted, other_.mdeleted);
+		swap(hash, other_.hash);
+		swap(load_alg, other_.load_alg);
+		swap(eq, other_.eq);
+		swap(allocator, other_.allocator);
+	}
+
+	//number of slots allocated by the set
+	size_t allocated() const
+	{
+		return group_count() * group_slots;
+	}
+
+	//number of elements plus deleted slots the set may hold before reallocating
+	size_t capacity() const
+	{
+		return mcapacity;
+	}
+
+	size_t size() const
+	{
+		return moccupied;
+	}
+
+	bool empty() const
+	{
+		return moccupied == 0;
+	}
+
+	const Instr& instrumentation() const
+	{
+		return instr;
+	}
+
+	//invalidates all iterators if the set has to grow
+	void reserve(size_t count_)
+	{
+		if (count_ > mcapacity)
+		{
+			reallocate(load_alg.allocated(count_));
+		}
+	}
+
+	//returns the element and true if it was inserted, false if it was present
+	//invalidates all iterators
+	template<class U>
+	std::pair<const T*, bool> insert(U&& value_)
+	{
+		if (auto s = find_slot(value_))
+		{
+			return { s, false };
+		}
+		return { insert_unique(std::forward<U>(value_)), true };
+	}
+
+	//invalidates iterators to the element
+	bool erase(const T& value_)
+	{
+		auto s = find_slot(value_);
+		if (!s)
+		{
+			return false;
+		}
+		auto index = size_t(s - mslots);
+		auto& g = mgroups[index / group_slots];
+		s->~T();
+		//no probe sequence went past a group that still has an empty slot,
+		//so the slot can be empty again rather than deleted
+		if (g.match(ctrl_empty))
+		{
+			g.ctrl[index % group_slots] = ctrl_empty;
+		}
+		else
+		{
+			g.ctrl[index % group_slots] = ctrl_deleted;
+			++mdeleted;
+		}
+		--moccupied;
+		return true;
+	}
+
+	void clear()
+	{
+		auto slots = allocated();
+		release();
+		init(slots);
+	}
+
+	//the element equal to value_, nullptr if there is none
+	const T* find(const T& value_) const
+	{
+		return find_slot(value_);
+	}
+
+	bool contains(const T& value_) const
+	{
+		return find_slot(value_) != nullptr;
+	}
+
+	size_t count(const T& value_) const
+	{
+		return contains(value_);
+	}
+
+	iterator begin() const
+	{
+		return iterator(this, 0);
+	}
+
+	iterator end() const
+	{
+		return iterator(this, allocated());
+	}
+};